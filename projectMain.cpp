@@ -1,322 +1,3844 @@
 #include <iostream>
 #include <string>
 #include <cstdlib>
+#include <cstddef>
 #include <ctime>
 #include <fstream>
 #include <cmath>
 #include <iomanip>
-#include <queue>
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <new>
+#include <mutex>
+#include <deque>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-struct Process {
-    std::string id;
-    int arrival_time;
+//read-only window on an array owned by someone else
+template <typename T>
+class ArrayView {
+public:
+    ArrayView() : items(nullptr), count(0) {}
+    ArrayView(const T* items, size_t count) : items(items), count(count) {}
+
+    const T& operator[](size_t i) const {
+        return items[i];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    const T* data() const {
+        return items;
+    }
+
+    const T* begin() const {
+        return items;
+    }
+
+    const T* end() const {
+        return items + count;
+    }
+
+private:
+    const T* items;
+    size_t count;
+};
+
+//ID of the process at index, kept as the index and only turned into text
+//when a line is printed: A0 to A9, then B0 and so on up to Z9, after which
+//the letters go on like spreadsheet columns (AA0 to ZZ9, AAA0, ...)
+struct ProcessId {
+    uint32_t index;
+
+    //writes the ID (at most 8 characters) to text and returns its end
+    char* format(char* text) const {
+        char letters[8];
+        int count = 0;
+        for (uint32_t rest = index / 10 + 1; rest > 0; rest = (rest - 1) / 26)
+            letters[count++] = 'A' + (rest - 1) % 26;
+        while (count > 0)
+            *text++ = letters[--count];
+        *text++ = '0' + index % 10;
+        return text;
+    }
+};
+
+std::ostream& operator<<(std::ostream& out, ProcessId id) {
+    char text[8];
+    return out.write(text, id.format(text) - text);
+}
+
+//the IDs of a workload, nothing is stored since they follow from the index
+struct ProcessIds {
+    ProcessId operator[](uint32_t index) const {
+        ProcessId id = {index};
+        return id;
+    }
+};
+
+//the read-only workload the simulators run on, the same arrays as a
+//ProcessTable but possibly living in a mapped workload file
+struct Workload {
+    ProcessIds id;
+    ArrayView<int> arrival_time;
+    ArrayView<char> is_cpu_bound;
+    ArrayView<uint32_t> first_burst;
+    ArrayView<uint32_t> num_bursts;
+    ArrayView<int> cpu_bursts;
+    ArrayView<int> io_bursts;
+    ArrayView<uint32_t> arrival_order;
+
+    uint32_t size() const {
+        return arrival_time.size();
+    }
+};
+
+//every process of the workload in structure-of-arrays form, the simulators
+//only ever pass 32-bit indices into it around
+struct ProcessTable {
+    ProcessIds id;
+    std::vector<int> arrival_time;
+    std::vector<char> is_cpu_bound;
+    std::vector<uint32_t> first_burst; //offset of the process's bursts in the pools
+    std::vector<uint32_t> num_bursts;
+    //flat burst pools shared by all processes, io_bursts[k] is the I/O burst
+    //after cpu_bursts[k] (0 after the last CPU burst of a process)
     std::vector<int> cpu_bursts;
     std::vector<int> io_bursts;
-    int current_burst_index;
-    int total_cpu_time;
-    int total_wait_time;
-    int total_turnaround_time;
-    int done_time;
-    bool is_cpu_bound;
-    int context_switch;
+    std::vector<uint32_t> arrival_order; //indices by arrival time, then ID
+
+    uint32_t size() const {
+        return arrival_time.size();
+    }
+
+    uint32_t add(int arrival, bool cpu_bound) {
+        arrival_time.push_back(arrival);
+        is_cpu_bound.push_back(cpu_bound);
+        first_burst.push_back(cpu_bursts.size());
+        num_bursts.push_back(0);
+        return arrival_time.size() - 1;
+    }
+
+    void reserve(uint32_t processes, uint32_t bursts) {
+        arrival_time.reserve(processes);
+        is_cpu_bound.reserve(processes);
+        first_burst.reserve(processes);
+        num_bursts.reserve(processes);
+        cpu_bursts.reserve(bursts);
+        io_bursts.reserve(bursts);
+    }
+
+    //appends count bursts to the process at index (which must be the last one
+    //added) and returns where they start in the pools, for the caller to fill
+    uint32_t add_bursts(uint32_t index, uint32_t count) {
+        uint32_t first = cpu_bursts.size();
+        cpu_bursts.resize(first + count);
+        io_bursts.resize(first + count);
+        num_bursts[index] += count;
+        return first;
+    }
+
+    //call once the table is filled, the simulators read arrivals in this order
+    void sort_arrivals() {
+        arrival_order.resize(size());
+        for (uint32_t i = 0; i < size(); i++)
+            arrival_order[i] = i;
+        std::stable_sort(arrival_order.begin(), arrival_order.end(), [this](uint32_t a, uint32_t b) {
+            return arrival_time[a] < arrival_time[b];
+        });
+    }
+
+    //for the simulators, valid until the table changes
+    Workload view() const {
+        Workload workload;
+        workload.arrival_time = ArrayView<int>(arrival_time.data(), arrival_time.size());
+        workload.is_cpu_bound = ArrayView<char>(is_cpu_bound.data(), is_cpu_bound.size());
+        workload.first_burst = ArrayView<uint32_t>(first_burst.data(), first_burst.size());
+        workload.num_bursts = ArrayView<uint32_t>(num_bursts.data(), num_bursts.size());
+        workload.cpu_bursts = ArrayView<int>(cpu_bursts.data(), cpu_bursts.size());
+        workload.io_bursts = ArrayView<int>(io_bursts.data(), io_bursts.size());
+        workload.arrival_order = ArrayView<uint32_t>(arrival_order.data(), arrival_order.size());
+        return workload;
+    }
+};
+
+//checkpoint fields in native byte order, vectors with their length first
+template <typename T>
+void put(std::ostream& out, const T& value) {
+    out.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+void put(std::ostream& out, const std::vector<T>& values) {
+    put(out, (uint64_t)values.size());
+    out.write((const char*)values.data(), values.size() * sizeof(T));
+}
+
+template <typename T>
+bool get(std::istream& in, T& value) {
+    return (bool)in.read((char*)&value, sizeof(T));
+}
+
+//a vector that must come back with the length it has now
+template <typename T>
+bool get(std::istream& in, std::vector<T>& values) {
+    uint64_t count;
+    if (!get(in, count) || count != values.size())
+        return false;
+    return (bool)in.read((char*)values.data(), count * sizeof(T));
+}
+
+//a vector that comes back with whatever length it was saved with, read a block
+//at a time so a corrupt length runs into the end of the file instead of memory
+template <typename T>
+bool get_resized(std::istream& in, std::vector<T>& values) {
+    uint64_t count;
+    if (!get(in, count))
+        return false;
+    values.clear();
+    while (values.size() < count) {
+        size_t start = values.size();
+        values.resize(start + std::min<uint64_t>(count - start, 4096));
+        if (!in.read((char*)(values.data() + start), (values.size() - start) * sizeof(T)))
+            return false;
+    }
+    return true;
+}
+
+//FIFO of process indices in a fixed ring buffer, a process sits in at most one
+//queue at a time so n slots are always enough and pushes never allocate
+class IndexQueue {
+public:
+    explicit IndexQueue(uint32_t capacity) : slots(capacity > 0 ? capacity : 1), head(0), count(0) {}
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    uint32_t size() const {
+        return count;
+    }
+
+    uint32_t front() const {
+        return slots[head];
+    }
+
+    uint32_t operator[](uint32_t i) const {
+        return slots[(head + i) % slots.size()];
+    }
+
+    void push(uint32_t index) {
+        slots[(head + count) % slots.size()] = index;
+        count++;
+    }
+
+    void pop() {
+        head = (head + 1) % slots.size();
+        count--;
+    }
+
+    //grows the ring to capacity slots, the queue keeps its order
+    void reserve(uint32_t capacity) {
+        if (capacity <= slots.size())
+            return;
+        std::vector<uint32_t> grown(capacity);
+        for (uint32_t i = 0; i < count; i++)
+            grown[i] = (*this)[i];
+        slots.swap(grown);
+        head = 0;
+    }
+
+    //the ring as it is, for a checkpoint of a streaming run
+    void save(std::ostream& out) const {
+        put(out, slots);
+        put(out, head);
+        put(out, count);
+    }
+
+    //back to what save() wrote, into a queue of the same capacity
+    bool load(std::istream& in) {
+        if (!get(in, slots) || !get(in, head) || !get(in, count) || head >= slots.size() || count > slots.size())
+            return false;
+        for (uint32_t i = 0; i < count; i++) {
+            if ((*this)[i] >= slots.size())
+                return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> slots;
+    uint32_t head;
+    uint32_t count;
+};
+
+//processes blocked on I/O as a binary min-heap on completion time, ties come
+//out in the order the processes blocked (same as the old scan of io_queue)
+class IoQueue {
+public:
+    explicit IoQueue(uint32_t capacity) : next_seq(0) {
+        heap.reserve(capacity);
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    //true while the earliest blocked process is done with I/O by now
+    bool due(int now) const {
+        return !heap.empty() && heap.front().done_time <= now;
+    }
+
+    void push(int done_time, uint32_t index) {
+        Entry entry = {done_time, next_seq++, index};
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    }
+
+    uint32_t pop() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        uint32_t index = heap.back().index;
+        heap.pop_back();
+        return index;
+    }
+
+    void save(std::ostream& out) const {
+        put(out, heap);
+        put(out, next_seq);
+    }
+
+    //back to what save() wrote, false if it holds a process index of n or more
+    bool load(std::istream& in, uint32_t n) {
+        if (!get_resized(in, heap) || !get(in, next_seq) || !std::is_heap(heap.begin(), heap.end(), std::greater<Entry>()))
+            return false;
+        for (size_t i = 0; i < heap.size(); i++) {
+            if (heap[i].index >= n)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    struct Entry {
+        int done_time;
+        uint64_t seq;
+        uint32_t index;
+
+        bool operator>(const Entry& other) const {
+            if (done_time != other.done_time)
+                return done_time > other.done_time;
+            return seq > other.seq;
+        }
+    };
+
+    std::vector<Entry> heap;
+    uint64_t next_seq;
+};
+
+//ready queue ordered by a per-process key (predicted burst for SJF/SRT), ties
+//go to the lower process index, i.e. ID order
+class ReadyHeap {
+public:
+    explicit ReadyHeap(uint32_t capacity) {
+        reserve(capacity);
+    }
+
+    void reserve(uint32_t capacity) {
+        heap.reserve(capacity);
+        sorted.reserve(capacity);
+        scratch.reserve(capacity);
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    uint32_t size() const {
+        return heap.size();
+    }
+
+    uint32_t front() const {
+        return heap.front().index;
+    }
+
+    int front_key() const {
+        return heap.front().key;
+    }
+
+    void push(uint32_t index, int key) {
+        Entry entry = {key, index};
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    }
+
+    void pop() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        heap.pop_back();
+    }
+
+    void save(std::ostream& out) const {
+        put(out, heap);
+    }
+
+    //back to what save() wrote, false if it holds a process index of n or more
+    bool load(std::istream& in, uint32_t n) {
+        if (!get_resized(in, heap) || !std::is_heap(heap.begin(), heap.end(), std::greater<Entry>()))
+            return false;
+        for (size_t i = 0; i < heap.size(); i++) {
+            if (heap[i].index >= n)
+                return false;
+        }
+        reserve(n);
+        return true;
+    }
+
+    //the queue in dispatch order, for printing
+    const std::vector<uint32_t>& ordered() const {
+        sorted.assign(heap.begin(), heap.end());
+        std::sort(sorted.begin(), sorted.end());
+        scratch.clear();
+        for (size_t i = 0; i < sorted.size(); i++)
+            scratch.push_back(sorted[i].index);
+        return scratch;
+    }
+
+private:
+    struct Entry {
+        int key;
+        uint32_t index;
+
+        bool operator<(const Entry& other) const {
+            if (key != other.key)
+                return key < other.key;
+            return index < other.index;
+        }
+
+        bool operator>(const Entry& other) const {
+            return other < *this;
+        }
+    };
+
+    std::vector<Entry> heap;
+    mutable std::vector<Entry> sorted;
+    mutable std::vector<uint32_t> scratch;
+};
+
+//ready processes split into priority levels, FIFO within a level and level 0
+//served first, for MLFQ; each level is an IndexQueue of n slots so no push allocates
+class LevelQueue {
+public:
+    LevelQueue(uint32_t capacity, uint32_t levels) : queues(levels, IndexQueue(capacity)), count(0) {}
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    uint32_t size() const {
+        return count;
+    }
+
+    uint32_t levels() const {
+        return queues.size();
+    }
+
+    const IndexQueue& level(uint32_t i) const {
+        return queues[i];
+    }
+
+    uint32_t front() const {
+        return queues[top()].front();
+    }
+
+    void push(uint32_t index, uint32_t level) {
+        queues[level].push(index);
+        count++;
+    }
+
+    void pop() {
+        queues[top()].pop();
+        count--;
+    }
+
+    void reserve(uint32_t capacity) {
+        for (uint32_t i = 0; i < queues.size(); i++)
+            queues[i].reserve(capacity);
+    }
+
+    void save(std::ostream& out) const {
+        for (uint32_t i = 0; i < queues.size(); i++)
+            queues[i].save(out);
+    }
+
+    //back to what save() wrote, into a queue of the same capacity and levels
+    bool load(std::istream& in) {
+        count = 0;
+        for (uint32_t i = 0; i < queues.size(); i++) {
+            if (!queues[i].load(in))
+                return false;
+            count += queues[i].size();
+        }
+        return true;
+    }
+
+    //moves every process to the end of level 0, keeping their dispatch order
+    void merge() {
+        for (uint32_t i = 1; i < queues.size(); i++) {
+            while (!queues[i].empty()) {
+                queues[0].push(queues[i].front());
+                queues[i].pop();
+            }
+        }
+    }
+
+private:
+    uint32_t top() const {
+        uint32_t i = 0;
+        while (queues[i].empty())
+            i++;
+        return i;
+    }
+
+    std::vector<IndexQueue> queues;
+    uint32_t count;
+};
+
+//generates the part I workload from its own random state, the 48-bit LCG of
+//srand48/drand48 kept per object like erand48's buffer, so any number of
+//generators can run at once and a seed still gives the same workload as always
+class WorkloadGenerator {
+public:
+    //same state srand48(seed) sets up, only the low 32 bits of the seed count
+    WorkloadGenerator(long seed, double lambda, int bound)
+        : state(((uint64_t)(uint32_t)seed << 16) | 0x330E), lambda(lambda), bound(bound) {}
+
+    //the value drand48 would return next
+    double uniform() {
+        state = (0x5DEECE66DULL * state + 0xB) & ((1ULL << 48) - 1);
+        return state * (1.0 / (1ULL << 48));
+    }
+
+    //exponentially distributed, values above bound are drawn again
+    double next_exp() {
+        while (true) {
+            double x = -log(uniform()) / lambda;
+            if (x <= bound)
+                return x;
+        }
+    }
+
+    //n processes of which the first ncpu are CPU-bound, each process's bursts
+    //written straight into the table's pools
+    void generate(ProcessTable& processes, int n, int ncpu) {
+        processes.reserve(processes.size() + n, processes.cpu_bursts.size() + 17 * n);
+        for (int i = 0; i < n; i++) {
+            int arrival_time = floor(next_exp());
+            int num_bursts = ceil(32 * uniform());
+            bool cpu_bound = i < ncpu;
+            uint32_t p = processes.add(arrival_time, cpu_bound);
+            uint32_t first = processes.add_bursts(p, num_bursts);
+            fill_bursts(cpu_bound, num_bursts, processes.cpu_bursts.data() + first, processes.io_bursts.data() + first);
+        }
+        processes.sort_arrivals();
+    }
+
+    //the CPU and I/O bursts of one process (the I/O burst after the last CPU burst is 0)
+    void fill_bursts(bool cpu_bound, int num_bursts, int* cpu, int* io) {
+        for (int j = 0; j < num_bursts; j++) {
+            if (cpu_bound) {
+                cpu[j] = 4 * ceil(next_exp());
+                io[j] = j < num_bursts - 1 ? ceil(next_exp()) : 0;
+            } else {
+                cpu[j] = ceil(next_exp());
+                io[j] = j < num_bursts - 1 ? 8 * ceil(next_exp()) : 0;
+            }
+        }
+    }
+
+    //the 48-bit random state, for checkpoints
+    uint64_t position() const {
+        return state;
+    }
+
+    void seek(uint64_t position) {
+        state = position & ((1ULL << 48) - 1);
+    }
+
+private:
+    uint64_t state;
+    double lambda;
+    int bound;
+};
+
+//workload files start with this header, followed by the process table as
+//arrays (int32 arrival_time, uint32 first_burst, num_bursts and arrival_order,
+//then one byte is_cpu_bound per process padded to 4 bytes) and the flat int32
+//cpu_bursts and io_bursts arrays, all in native byte order
+struct WorkloadHeader {
+    char magic[8]; //"OPSYSWL1"
+    uint32_t version;
+    uint32_t num_processes;
+    uint64_t num_bursts;
+    uint64_t reserved;
+};
+
+static const char WORKLOAD_MAGIC[8] = {'O', 'P', 'S', 'Y', 'S', 'W', 'L', '1'};
+static const uint32_t WORKLOAD_VERSION = 1;
+
+//bytes of the workload file holding n processes and the given number of bursts
+size_t workload_file_size(uint64_t n, uint64_t bursts) {
+    return sizeof(WorkloadHeader) + 16 * n + ((n + 3) & ~(uint64_t)3) + 8 * bursts;
+}
+
+bool save_workload(const Workload& workload, const std::string& path) {
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file)
+        return false;
+    WorkloadHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WORKLOAD_MAGIC, sizeof(header.magic));
+    header.version = WORKLOAD_VERSION;
+    header.num_processes = workload.size();
+    header.num_bursts = workload.cpu_bursts.size();
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)workload.arrival_time.data(), 4 * workload.size());
+    file.write((const char*)workload.first_burst.data(), 4 * workload.size());
+    file.write((const char*)workload.num_bursts.data(), 4 * workload.size());
+    file.write((const char*)workload.arrival_order.data(), 4 * workload.size());
+    file.write(workload.is_cpu_bound.data(), workload.size());
+    const char padding[4] = {0, 0, 0, 0};
+    file.write(padding, (4 - workload.size() % 4) % 4);
+    file.write((const char*)workload.cpu_bursts.data(), 4 * workload.cpu_bursts.size());
+    file.write((const char*)workload.io_bursts.data(), 4 * workload.io_bursts.size());
+    return (bool)file;
+}
+
+//a workload file mapped into memory, the simulators read its arrays in place
+//and nothing gets built on load
+class WorkloadFile {
+public:
+    WorkloadFile() : mapping(MAP_FAILED), length(0) {}
+
+    ~WorkloadFile() {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, length);
+    }
+
+    WorkloadFile(const WorkloadFile&) = delete;
+    WorkloadFile& operator=(const WorkloadFile&) = delete;
+
+    bool open(const std::string& path, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = strerror(errno);
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(WorkloadHeader)) {
+            error = "not a workload file";
+            close(fd);
+            return false;
+        }
+        length = info.st_size;
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            error = strerror(errno);
+            return false;
+        }
+
+        const WorkloadHeader* header = (const WorkloadHeader*)mapping;
+        if (memcmp(header->magic, WORKLOAD_MAGIC, sizeof(header->magic)) != 0 || header->version != WORKLOAD_VERSION) {
+            error = "not a workload file";
+            return false;
+        }
+        uint32_t n = header->num_processes;
+        uint64_t bursts = header->num_bursts;
+        if (bursts > UINT32_MAX || length != workload_file_size(n, bursts)) {
+            error = "workload file has the wrong size";
+            return false;
+        }
+
+        const char* next = (const char*)mapping + sizeof(WorkloadHeader);
+        view.arrival_time = ArrayView<int>((const int*)next, n);
+        next += 4 * n;
+        view.first_burst = ArrayView<uint32_t>((const uint32_t*)next, n);
+        next += 4 * n;
+        view.num_bursts = ArrayView<uint32_t>((const uint32_t*)next, n);
+        next += 4 * n;
+        view.arrival_order = ArrayView<uint32_t>((const uint32_t*)next, n);
+        next += 4 * n;
+        view.is_cpu_bound = ArrayView<char>(next, n);
+        next += (n + 3) & ~3u;
+        view.cpu_bursts = ArrayView<int>((const int*)next, bursts);
+        next += 4 * bursts;
+        view.io_bursts = ArrayView<int>((const int*)next, bursts);
+
+        //the simulators trust the table, so check it once here; the clock never
+        //gets past the last arrival plus every burst, which has to fit in an int
+        std::vector<char> seen(n, 0);
+        int64_t last_arrival = 0;
+        int64_t total = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (view.num_bursts[i] == 0 || (uint64_t)view.first_burst[i] + view.num_bursts[i] > bursts || view.arrival_time[i] < 0) {
+                error = "bad process table";
+                return false;
+            }
+            for (uint32_t k = view.first_burst[i]; k < view.first_burst[i] + view.num_bursts[i]; k++) {
+                if (view.cpu_bursts[k] < 1 || view.io_bursts[k] < 0) {
+                    error = "bad burst length";
+                    return false;
+                }
+                total += (int64_t)view.cpu_bursts[k] + view.io_bursts[k];
+            }
+            last_arrival = std::max(last_arrival, (int64_t)view.arrival_time[i]);
+            if (last_arrival + total > INT_MAX) {
+                error = "burst times overflow";
+                return false;
+            }
+            uint32_t p = view.arrival_order[i];
+            if (p >= n || seen[p] || (i > 0 && view.arrival_time[p] < view.arrival_time[view.arrival_order[i - 1]])) {
+                error = "bad arrival order";
+                return false;
+            }
+            seen[p] = 1;
+        }
+        return true;
+    }
+
+    const Workload& workload() const {
+        return view;
+    }
+
+private:
+    void* mapping;
+    size_t length;
+    Workload view;
+};
+
+//the CPU burst a process is on, its full length next to what is left of it so
+//dispatch, preemption and the statistics need no lookups in the burst pools
+struct BurstState {
+    int original;
+    int remaining;
+    bool preempted; //cut short before (preempted, or its time slice expired)
+
+    void start(int length) {
+        original = length;
+        remaining = length;
+        preempted = false;
+    }
+};
+
+//one BurstState per process, each on its first CPU burst
+std::vector<BurstState> first_bursts(const Workload& processes) {
+    std::vector<BurstState> bursts(processes.size());
+    for (uint32_t p = 0; p < processes.size(); p++)
+        bursts[p].start(processes.cpu_bursts[processes.first_burst[p]]);
+    return bursts;
+}
+
+//pending points in simulated time (arrivals, I/O completions, context switch
+//and burst boundaries), the simulators jump from one to the next instead of
+//stepping through every millisecond
+class EventQueue {
+public:
+    EventQueue() : steps(0) {}
+
+    void schedule(int time) {
+        times.push_back(time);
+        std::push_heap(times.begin(), times.end(), std::greater<int>());
+    }
+
+    int first_time() const {
+        return times.empty() ? 0 : times.front();
+    }
+
+    //drops everything at or before now and returns the next event time
+    //(or the following millisecond if nothing is pending)
+    int advance(int now) {
+        steps++;
+        while (!times.empty() && times.front() <= now) {
+            std::pop_heap(times.begin(), times.end(), std::greater<int>());
+            times.pop_back();
+        }
+        if (times.empty())
+            return now + 1;
+        return times.front();
+    }
+
+    //the pending times and the step count, for a checkpoint of a streaming run
+    void save(std::ostream& out) const {
+        put(out, times);
+        put(out, steps);
+    }
+
+    bool load(std::istream& in) {
+        return get_resized(in, times) && get(in, steps) && std::is_heap(times.begin(), times.end(), std::greater<int>());
+    }
+
+    //how many times the simulation advanced, for --bench
+    long count() const {
+        return steps;
+    }
+
+private:
+    std::vector<int> times; //min-heap
+    long steps;
+};
+
+//scheduling events in the telemetry stream, what value holds in a TelemetryRecord
+enum TelemetryKind {
+    EVENT_ARRIVAL,      //length of the first CPU burst
+    EVENT_DISPATCH,     //started using the CPU, ms of the burst left
+    EVENT_BURST_DONE,   //length of the burst
+    EVENT_PREEMPT,      //ms of the burst left
+    EVENT_IO_BLOCK,     //time the I/O completes
+    EVENT_IO_DONE,      //0
+    EVENT_SWITCH_BEGIN, //0 switching in, 1 switching out
+    EVENT_SWITCH_END,   //as for EVENT_SWITCH_BEGIN
+    EVENT_TERMINATE     //0
+};
+
+//one event as kept in the ring and written to the telemetry file, 16 bytes
+struct TelemetryRecord {
+    int32_t time;
+    uint32_t process;
+    int32_t value;
+    uint8_t kind;   //TelemetryKind
+    uint8_t policy; //Policy of the simulation
+    uint16_t core;  //CPU, 0 with a single CPU
+};
+
+//telemetry files start with this header, followed by TelemetryRecords up to
+//the end of the file in the order they were drained, native byte order
+struct TelemetryHeader {
+    char magic[8]; //"OPSYSTL1"
+    uint32_t version;
+    uint32_t record_size;
+};
+
+static const char TELEMETRY_MAGIC[8] = {'O', 'P', 'S', 'Y', 'S', 'T', 'L', '1'};
+static const uint32_t TELEMETRY_VERSION = 1;
+
+//single producer, single consumer ring of records: one simulation pushes and
+//the writer thread drains, with nothing shared but the two counters
+class TelemetryRing {
+public:
+    static const uint32_t CAPACITY = 1 << 16;
+
+    explicit TelemetryRing(int policy) : records(CAPACITY), head(0), tail(0), policy(policy) {}
+
+    //waits for the writer while the ring is full, no event is ever dropped
+    void push(TelemetryKind kind, int time, uint32_t process, int core, int value) {
+        uint64_t slot = tail.load(std::memory_order_relaxed);
+        while (slot - head.load(std::memory_order_acquire) >= CAPACITY)
+            std::this_thread::yield();
+        TelemetryRecord& record = records[slot & (CAPACITY - 1)];
+        record.time = time;
+        record.process = process;
+        record.value = value;
+        record.kind = kind;
+        record.policy = policy;
+        record.core = core;
+        tail.store(slot + 1, std::memory_order_release);
+    }
+
+    //writes out everything pushed so far and returns how many records that was
+    uint64_t drain(std::ostream& out) {
+        uint64_t first = head.load(std::memory_order_relaxed);
+        uint64_t count = tail.load(std::memory_order_acquire) - first;
+        if (count == 0)
+            return 0;
+        uint64_t start = first & (CAPACITY - 1);
+        uint64_t before_wrap = std::min<uint64_t>(count, CAPACITY - start);
+        out.write((const char*)&records[start], before_wrap * sizeof(TelemetryRecord));
+        out.write((const char*)&records[0], (count - before_wrap) * sizeof(TelemetryRecord));
+        head.store(first + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<TelemetryRecord> records;
+    alignas(64) std::atomic<uint64_t> head; //next record the writer takes
+    alignas(64) std::atomic<uint64_t> tail; //next slot the simulation fills
+    int policy;
+};
+
+//the telemetry file and the background thread that drains every ring into it
+class TelemetryWriter {
+public:
+    TelemetryWriter() : stop(false) {}
+
+    ~TelemetryWriter() {
+        close();
+    }
+
+    bool open(const std::string& path) {
+        file.open(path.c_str(), std::ios::binary);
+        if (!file)
+            return false;
+        TelemetryHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TELEMETRY_MAGIC, sizeof(header.magic));
+        header.version = TELEMETRY_VERSION;
+        header.record_size = sizeof(TelemetryRecord);
+        file.write((const char*)&header, sizeof(header));
+        worker = std::thread([this]() {
+            while (!stop.load()) {
+                if (drain() == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+        return (bool)file;
+    }
+
+    bool is_open() const {
+        return file.is_open();
+    }
+
+    //a ring for one simulation, it lives as long as the writer
+    TelemetryRing* ring(int policy) {
+        std::lock_guard<std::mutex> lock(rings_lock);
+        rings.emplace_back(policy);
+        return &rings.back();
+    }
+
+    //stops the thread once everything pushed so far is written, true if the file is complete
+    bool close() {
+        if (!file.is_open())
+            return true;
+        stop = true;
+        worker.join();
+        drain();
+        bool written = (bool)file;
+        file.close();
+        return written;
+    }
+
+private:
+    uint64_t drain() {
+        std::lock_guard<std::mutex> lock(rings_lock);
+        uint64_t count = 0;
+        for (size_t i = 0; i < rings.size(); i++)
+            count += rings[i].drain(file);
+        return count;
+    }
+
+    std::ofstream file;
+    std::deque<TelemetryRing> rings; //never moved, the simulations hold pointers
+    std::mutex rings_lock;
+    std::thread worker;
+    std::atomic<bool> stop;
+};
+
+//how much of the simulator trace gets printed
+enum TraceLevel {
+    TRACE_NONE,      //statistics only
+    TRACE_TRUNCATED, //most events only until 10000ms
+    TRACE_FULL
+};
+
+//trace output collected in one large reusable buffer and written out in big
+//blocks instead of flushing every line, at TRACE_NONE nothing is formatted
+class TraceSink {
+public:
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    TraceSink(std::ostream& out, TraceLevel level) : out(out), level(level), telemetry(nullptr), tag_text("") {
+        buffer.reserve(BUFFER_SIZE + 256);
+    }
+
+    ~TraceSink() {
+        flush();
+    }
+
+    bool on() const {
+        return level != TRACE_NONE;
+    }
+
+    //whether the events that are cut from truncated traces show at this time
+    bool shows(int time) const {
+        return level == TRACE_FULL || (level == TRACE_TRUNCATED && time < 10000);
+    }
+
+    TraceSink& operator<<(const char* text) {
+        if (on()) {
+            buffer.append(text);
+            spill();
+        }
+        return *this;
+    }
+
+    TraceSink& operator<<(const std::string& text) {
+        if (on()) {
+            buffer.append(text);
+            spill();
+        }
+        return *this;
+    }
+
+    TraceSink& operator<<(ProcessId id) {
+        if (on()) {
+            char text[8];
+            buffer.append(text, id.format(text));
+            spill();
+        }
+        return *this;
+    }
+
+    TraceSink& operator<<(char c) {
+        if (on()) {
+            buffer.push_back(c);
+            spill();
+        }
+        return *this;
+    }
+
+    TraceSink& operator<<(long long value) {
+        if (on()) {
+            char digits[24];
+            buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+            spill();
+        }
+        return *this;
+    }
+
+    TraceSink& operator<<(int value) {
+        return *this << (long long)value;
+    }
+
+    TraceSink& operator<<(uint32_t value) {
+        return *this << (long long)value;
+    }
+
+    //starts a trace line at time, with the tag set by set_tag() after the time
+    TraceSink& line(int time) {
+        return *this << "time " << time << "ms: " << tag_text;
+    }
+
+    //tag for the lines started by line(), "[CPU c] " while a policy reports for a core
+    void set_tag(const char* tag) {
+        tag_text = tag;
+    }
+
+    void flush() {
+        if (!buffer.empty()) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+        out.flush();
+    }
+
+    //also send the events of the next simulation to ring, nullptr for none
+    void set_telemetry(TelemetryRing* ring) {
+        telemetry = ring;
+    }
+
+    //one scheduling event for the telemetry stream, whatever the trace level
+    void record(TelemetryKind kind, int time, uint32_t process, int core, int value) {
+        if (telemetry)
+            telemetry->push(kind, time, process, core, value);
+    }
+
+private:
+    void spill() {
+        if (buffer.size() >= BUFFER_SIZE) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    std::ostream& out;
+    TraceLevel level;
+    std::string buffer;
+    TelemetryRing* telemetry;
+    const char* tag_text;
+};
+
+//output checked against a reference file as it is written, one line at a time
+//so neither side is ever held in memory; keeps the first line that differs
+//(a trailing '\r' is ignored on both sides so CRLF references still match)
+class TraceVerifier : public std::streambuf {
+public:
+    explicit TraceVerifier(const std::string& path) : lines(0), differs(false) {
+        reference_buffer.resize(1 << 20);
+        reference.rdbuf()->pubsetbuf(&reference_buffer[0], reference_buffer.size());
+        reference.open(path);
+    }
+
+    bool is_open() const {
+        return reference.is_open();
+    }
+
+    //compares the last unterminated line and checks the reference ends here too,
+    //true if everything matched
+    bool finish() {
+        if (!actual.empty())
+            compare();
+        if (!differs && std::getline(reference, expected)) {
+            lines++;
+            differs = true;
+            first_actual = "(end of output)";
+            first_expected = expected;
+        }
+        return !differs;
+    }
+
+    //where the output first left the reference, with the simulated time and
+    //the algorithm it happened in
+    void report(std::ostream& out, const std::string& path) const {
+        if (!differs) {
+            out << "Output matches " << path << " (" << lines << " lines)" << std::endl;
+            return;
+        }
+        out << "Output differs from " << path << " at line " << lines;
+        int time = event_time(first_actual.compare(0, 5, "time ") == 0 ? first_actual : first_expected);
+        if (time >= 0)
+            out << " (time " << time << "ms" << (algorithm.empty() ? "" : ", ") << algorithm << ")";
+        else if (!algorithm.empty())
+            out << " (" << algorithm << ")";
+        out << "\n  expected: " << first_expected << "\n  actual:   " << first_actual << std::endl;
+    }
+
+protected:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) {
+            char text = c;
+            xsputn(&text, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* text, std::streamsize count) override {
+        if (differs)
+            return count;
+        const char* end = text + count;
+        while (text < end) {
+            const char* newline = (const char*)memchr(text, '\n', end - text);
+            if (!newline) {
+                actual.append(text, end);
+                break;
+            }
+            actual.append(text, newline);
+            compare();
+            text = newline + 1;
+            if (differs)
+                break;
+        }
+        return count;
+    }
+
+private:
+    void compare() {
+        if (!actual.empty() && actual.back() == '\r')
+            actual.pop_back();
+        lines++;
+        bool more = (bool)std::getline(reference, expected);
+        if (more && !expected.empty() && expected.back() == '\r')
+            expected.pop_back();
+        size_t started = actual.find("Simulator started for ");
+        if (started != std::string::npos) {
+            started += 22;
+            algorithm = actual.substr(started, actual.find(' ', started) - started);
+        }
+        if (!more || actual != expected) {
+            differs = true;
+            first_actual = actual;
+            first_expected = more ? expected : "(end of reference)";
+        }
+        actual.clear();
+    }
+
+    //the time of a "time Xms: ..." trace line, -1 for other lines
+    static int event_time(const std::string& line) {
+        if (line.compare(0, 5, "time ") != 0)
+            return -1;
+        return std::atoi(line.c_str() + 5);
+    }
+
+    std::ifstream reference;
+    std::vector<char> reference_buffer;
+    std::string actual;   //output line being collected
+    std::string expected; //reference line it is compared with
+    std::string algorithm; //last "Simulator started for" seen
+    long lines;
+    bool differs;
+    std::string first_actual;
+    std::string first_expected;
+};
+
+//puts a stream back on its own buffer when it goes out of scope
+struct StreamRestore {
+    std::ostream& stream;
+    std::streambuf* saved;
+
+    ~StreamRestore() {
+        stream.rdbuf(saved);
+    }
+};
+
+void print_queue(TraceSink& trace, const IndexQueue& queue, const Workload& processes){
+    if (!trace.on())
+        return;
+    if(queue.empty()){
+        trace << " empty]\n";
+        return;
+    }
+    for (uint32_t i = 0; i < queue.size(); i++) {
+        trace << ' ' << processes.id[queue[i]];
+    }
+    trace << "]\n";
+}
+
+void print_queue(TraceSink& trace, const ReadyHeap& queue, const Workload& processes){
+    if (!trace.on())
+        return;
+    if(queue.empty()){
+        trace << " empty]\n";
+        return;
+    }
+    const std::vector<uint32_t>& ordered = queue.ordered();
+    for (uint32_t i = 0; i < ordered.size(); i++) {
+        trace << ' ' << processes.id[ordered[i]];
+    }
+    trace << "]\n";
+}
+
+void print_queue(TraceSink& trace, const LevelQueue& queue, const Workload& processes){
+    if (!trace.on())
+        return;
+    if(queue.empty()){
+        trace << " empty]\n";
+        return;
+    }
+    for (uint32_t level = 0; level < queue.levels(); level++) {
+        for (uint32_t i = 0; i < queue.level(level).size(); i++) {
+            trace << ' ' << processes.id[queue.level(level)[i]];
+        }
+    }
+    trace << "]\n";
+}
+
+//fixed-size log-linear histogram of non-negative ms values (HDR style): exact
+//below 128, above that 64 buckets per power of two so any value is off by
+//less than 1/64; recording is O(1) and memory never grows
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 6;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = (31 - SUB_BITS) * SUB + 2 * SUB;
+
+    LatencyHistogram() : total(0), max_value(0) {
+        memset(counts, 0, sizeof(counts));
+    }
+
+    void record(int value) {
+        uint32_t v = value > 0 ? value : 0;
+        counts[bucket(v)]++;
+        total++;
+        max_value = std::max(max_value, v);
+    }
+
+    //this and other as one histogram, for the overall figures
+    LatencyHistogram merged(const LatencyHistogram& other) const {
+        LatencyHistogram result(*this);
+        for (int i = 0; i < BUCKETS; i++)
+            result.counts[i] += other.counts[i];
+        result.total += other.total;
+        result.max_value = std::max(max_value, other.max_value);
+        return result;
+    }
+
+    //the value below which fraction of the recorded values fall, reported as the
+    //top of its bucket (never above the largest value seen), 0 when empty
+    int percentile(double fraction) const {
+        if (total == 0)
+            return 0;
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)ceil(fraction * total));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= target)
+                return std::min(highest(i), max_value);
+        }
+        return max_value;
+    }
+
+private:
+    static int bucket(uint32_t v) {
+        if (v < 2 * SUB)
+            return v;
+        int shift = 31 - __builtin_clz(v) - SUB_BITS;
+        return shift * SUB + (v >> shift);
+    }
+
+    //largest value that lands in bucket i
+    static uint32_t highest(int i) {
+        if (i < 2 * SUB)
+            return i;
+        int shift = i / SUB - 1;
+        return (((uint32_t)(i - shift * SUB) + 1) << shift) - 1;
+    }
+
+    uint64_t counts[BUCKETS];
+    uint64_t total;
+    uint32_t max_value;
+};
+
+//percentiles reported from each LatencyHistogram
+static const double PERCENTILES[4] = {0.5, 0.9, 0.99, 0.999};
+
+//what one simulation reports, indexed [0] CPU-bound, [1] I/O-bound, [2] overall
+struct SimSummary {
+    double utilization;
+    std::vector<double> core_utilization; //only with more than one CPU
+    double wait_time[3];
+    double turnaround_time[3];
+    int context_switches[3];
+    int preemptions[3];
+    int migrations[3];
+    bool has_slices; //RR, the one_slice percentages apply
+    double one_slice[3];
+    long events; //event times the simulation stepped through
+    double run_time; //ms the CPUs ran processes, all of the CPU bursts once every process terminated
+    //[0] wait, [1] turnaround, [2] response time per class, at each of PERCENTILES
+    int percentiles[3][3][4];
+};
+
+//rounded up to 3 decimals like the part I averages
+double ceil3(double value) {
+    return ceil(1000 * value) / 1000;
+}
+
+//appends the simout.txt block of one algorithm
+//percentiles adds the wait, turnaround and response time tails after the averages
+void write_stats(std::ostream& out, const char* name, const SimSummary& summary, bool percentiles = false) {
+    const char* labels[3] = {"CPU-bound", "I/O-bound", "overall"};
+    out << std::fixed << std::setprecision(3);
+    out << std::endl << "Algorithm " << name << std::endl;
+    out << "-- CPU utilization: " << ceil3(summary.utilization) << "%" << std::endl;
+    for (size_t core = 0; core < summary.core_utilization.size(); core++)
+        out << "-- CPU " << core << " utilization: " << ceil3(summary.core_utilization[core]) << "%" << std::endl;
+    for (int c = 0; c < 3; c++)
+        out << "-- " << labels[c] << " average wait time: " << ceil3(summary.wait_time[c]) << " ms" << std::endl;
+    for (int c = 0; c < 3; c++)
+        out << "-- " << labels[c] << " average turnaround time: " << ceil3(summary.turnaround_time[c]) << " ms" << std::endl;
+    for (int c = 0; c < 3; c++)
+        out << "-- " << labels[c] << " number of context switches: " << summary.context_switches[c] << std::endl;
+    for (int c = 0; c < 3; c++)
+        out << "-- " << labels[c] << " number of preemptions: " << summary.preemptions[c] << std::endl;
+    if (!summary.core_utilization.empty()) {
+        for (int c = 0; c < 3; c++)
+            out << "-- " << labels[c] << " number of migrations: " << summary.migrations[c] << std::endl;
+    }
+    if (summary.has_slices) {
+        for (int c = 0; c < 3; c++)
+            out << "-- " << labels[c] << " percentage of CPU bursts completed within one time slice: " << ceil3(summary.one_slice[c]) << "%" << std::endl;
+    }
+    if (percentiles) {
+        const char* metrics[3] = {"wait time", "turnaround time", "response time"};
+        for (int m = 0; m < 3; m++) {
+            for (int c = 0; c < 3; c++) {
+                const int* values = summary.percentiles[m][c];
+                out << "-- " << labels[c] << " " << metrics[m] << " p50/p90/p99/p99.9: " << values[0] << "/" << values[1] << "/" << values[2] << "/"
+                    << values[3] << " ms" << std::endl;
+            }
+        }
+    }
+}
+
+//statistics of one simulation, updated by the simulators as events happen and
+//kept per class ([0] CPU-bound, [1] I/O-bound) so the summary needs no post-pass
+class SimStats {
+public:
+    explicit SimStats(const Workload& processes, int cores = 1)
+        : processes(processes), burst_start(processes.size(), 0), ready_since(processes.size(), 0), burst_wait(processes.size(), 0),
+          responded(processes.size(), 0), cpu_time(0), core_time(cores, 0) {
+        for (int c = 0; c < 2; c++) {
+            bursts[c] = 0;
+            wait_time[c] = 0;
+            turnaround_time[c] = 0;
+            context_switches[c] = 0;
+            preemptions[c] = 0;
+            one_slice[c] = 0;
+            migrations[c] = 0;
+        }
+    }
+
+    //room for processes up to n, for a streaming run that adds process slots
+    void resize(uint32_t n) {
+        burst_start.resize(n, 0);
+        ready_since.resize(n, 0);
+        burst_wait.resize(n, 0);
+        responded.resize(n, 0);
+    }
+
+    //a CPU burst enters the ready queue (arrival or I/O completion)
+    void ready(uint32_t p, int now) {
+        burst_start[p] = now;
+        ready_since[p] = now;
+        burst_wait[p] = 0;
+        responded[p] = 0;
+    }
+
+    //a preempted burst goes back into the ready queue
+    void requeued(uint32_t p, int now) {
+        ready_since[p] = now;
+        preemptions[cls(p)]++;
+    }
+
+    //p leaves the ready queue, its switch in starts at start
+    void switch_in(uint32_t p, int start) {
+        wait_time[cls(p)] += start - ready_since[p];
+        burst_wait[p] += start - ready_since[p];
+        context_switches[cls(p)]++;
+        //response time: from becoming ready to the first switch in of the burst
+        if (!responded[p]) {
+            responded[p] = 1;
+            histograms[2][cls(p)].record(start - burst_start[p]);
+        }
+    }
+
+    //p gets switched in on a different CPU than the one it last ran on
+    void migrated(uint32_t p) {
+        migrations[cls(p)]++;
+    }
+
+    //core spent ms running a process
+    void ran(int core, int ms) {
+        core_time[core] += ms;
+    }
+
+    //a CPU burst of burst_time ms finished, switched_out is when p is off the CPU
+    void burst_done(uint32_t p, int burst_time, int switched_out, bool within_slice) {
+        bursts[cls(p)]++;
+        turnaround_time[cls(p)] += switched_out - burst_start[p];
+        histograms[0][cls(p)].record(burst_wait[p]);
+        histograms[1][cls(p)].record(switched_out - burst_start[p]);
+        cpu_time += burst_time;
+        if (within_slice)
+            one_slice[cls(p)]++;
+    }
+
+    //everything collected so far, for a checkpoint of a streaming run
+    void save(std::ostream& out) const {
+        put(out, burst_start);
+        put(out, ready_since);
+        put(out, burst_wait);
+        put(out, responded);
+        put(out, histograms);
+        put(out, bursts);
+        put(out, wait_time);
+        put(out, turnaround_time);
+        put(out, context_switches);
+        put(out, preemptions);
+        put(out, one_slice);
+        put(out, migrations);
+        put(out, cpu_time);
+        put(out, core_time);
+    }
+
+    //back to what save() wrote, for the same number of processes and CPUs
+    bool load(std::istream& in) {
+        return get(in, burst_start) && get(in, ready_since) && get(in, burst_wait) && get(in, responded) && get(in, histograms) && get(in, bursts)
+               && get(in, wait_time) && get(in, turnaround_time) && get(in, context_switches) && get(in, preemptions) && get(in, one_slice)
+               && get(in, migrations) && get(in, cpu_time) && get(in, core_time);
+    }
+
+    //the averages and counts of the run, which ended at end_time
+    SimSummary summary(int end_time, bool slices, long events) const {
+        SimSummary result;
+        int cores = core_time.size();
+        result.utilization = end_time > 0 ? 100 * cpu_time / cores / end_time : 0;
+        if (cores > 1) {
+            for (int core = 0; core < cores; core++)
+                result.core_utilization.push_back(end_time > 0 ? 100 * core_time[core] / end_time : 0);
+        }
+        int total_bursts = bursts[0] + bursts[1];
+        for (int c = 0; c < 3; c++) {
+            int count = c < 2 ? bursts[c] : total_bursts;
+            result.wait_time[c] = count > 0 ? (c < 2 ? wait_time[c] : wait_time[0] + wait_time[1]) / count : 0;
+            result.turnaround_time[c] = count > 0 ? (c < 2 ? turnaround_time[c] : turnaround_time[0] + turnaround_time[1]) / count : 0;
+            result.context_switches[c] = c < 2 ? context_switches[c] : context_switches[0] + context_switches[1];
+            result.preemptions[c] = c < 2 ? preemptions[c] : preemptions[0] + preemptions[1];
+            result.migrations[c] = c < 2 ? migrations[c] : migrations[0] + migrations[1];
+            result.one_slice[c] = count > 0 ? 100.0 * (c < 2 ? one_slice[c] : one_slice[0] + one_slice[1]) / count : 0;
+        }
+        result.has_slices = slices;
+        result.events = events;
+        result.run_time = 0;
+        for (int core = 0; core < cores; core++)
+            result.run_time += core_time[core];
+        for (int m = 0; m < 3; m++) {
+            LatencyHistogram overall = histograms[m][0].merged(histograms[m][1]);
+            for (int k = 0; k < 4; k++) {
+                result.percentiles[m][0][k] = histograms[m][0].percentile(PERCENTILES[k]);
+                result.percentiles[m][1][k] = histograms[m][1].percentile(PERCENTILES[k]);
+                result.percentiles[m][2][k] = overall.percentile(PERCENTILES[k]);
+            }
+        }
+        return result;
+    }
+
+private:
+    int cls(uint32_t p) const {
+        return processes.is_cpu_bound[p] ? 0 : 1;
+    }
+
+    const Workload& processes;
+    std::vector<int> burst_start; //when the current CPU burst of each process became ready
+    std::vector<int> ready_since; //when each process last entered the ready queue
+    std::vector<int> burst_wait;  //time the current CPU burst has spent in the ready queue
+    std::vector<char> responded;  //the current CPU burst has been switched in once
+    LatencyHistogram histograms[3][2]; //per burst [0] wait, [1] turnaround, [2] response, by class
+    int bursts[2];
+    double wait_time[2];
+    double turnaround_time[2];
+    int context_switches[2];
+    int preemptions[2];
+    int one_slice[2];
+    int migrations[2];
+    double cpu_time;
+    std::vector<double> core_time;
+};
+
+//default rules of simulate(), a policy derives from this and hides what it does
+//differently; simulate() is instantiated for each policy class, so the event
+//loop calls the rules directly and nothing is virtual; every policy also has
+//resize(), save() and load() for the process slots and checkpoints of streaming runs
+struct PolicyBase {
+    static const bool TIME_SLICED = false; //RR's within one time slice statistic applies
+    static const bool BASELINE_TRACE = false; //see FcfsPolicy
+
+    //the end line, RR has always printed "[Q Empty]"
+    const char* end_queue() const {
+        return "[Q empty]";
+    }
+
+    //printed after a process's ID in its arrival, I/O, start and burst lines
+    void describe(TraceSink& /*trace*/, uint32_t /*p*/) const {}
+
+    //printed after the ID of a running process being preempted with left ms to go
+    void describe_running(TraceSink& /*trace*/, uint32_t /*p*/, const BurstState& /*burst*/, int /*left*/) const {}
+
+    //p arrives as a new process
+    void arrived(uint32_t /*p*/) {}
+
+    //p was taken from the ready queue of from, another instance of the same
+    //policy on another CPU, and carries on here with what from knew about it
+    template <typename Policy>
+    void adopt(uint32_t /*p*/, const Policy& /*from*/) {}
+
+    //called at every event time before arrivals and I/O completions
+    void advance(int /*now*/, TraceSink& /*trace*/, const Workload& /*processes*/) {}
+
+    //how long process p runs once it has the CPU before the policy looks at it again
+    int run_length(uint32_t /*p*/, const BurstState& burst) {
+        return burst.remaining;
+    }
+
+    //p gave up the CPU after running for ms
+    void charge(uint32_t /*p*/, int /*ms*/) {}
+
+    //whether p, its time slice used up, gives the CPU to the (non-empty) ready queue
+    bool yields(uint32_t /*p*/) const {
+        return true;
+    }
+
+    //whether ready process p takes the CPU from running, which has left ms to go
+    bool beats(uint32_t /*p*/, const BurstState& /*burst*/, uint32_t /*running*/, const BurstState& /*running_burst*/, int /*left*/) const {
+        return false;
+    }
+
+    //p finished a CPU burst of length ms and has more to go
+    void burst_done(uint32_t /*p*/, int /*length*/, int /*now*/, TraceSink& /*trace*/, const Workload& /*processes*/) {}
+};
+
+//first come first served, one FIFO ready queue
+class FcfsPolicy : public PolicyBase {
+public:
+    //FCFS and RR keep the quirks of the baseline trace so their output stays
+    //byte for byte the same: a start line for the last process when a switch
+    //out leaves the CPU idle, and "1 bursts to go"
+    static const bool BASELINE_TRACE = true;
+
+    explicit FcfsPolicy(uint32_t n) : ready_queue(n) {}
+
+    const char* name() const {
+        return "FCFS";
+    }
+
+    bool empty() const {
+        return ready_queue.empty();
+    }
+
+    uint32_t size() const {
+        return ready_queue.size();
+    }
+
+    uint32_t front() const {
+        return ready_queue.front();
+    }
+
+    void pop() {
+        ready_queue.pop();
+    }
+
+    void push(uint32_t p, const BurstState& /*burst*/) {
+        ready_queue.push(p);
+    }
+
+    const IndexQueue& queue() const {
+        return ready_queue;
+    }
+
+    //room for processes up to n
+    void resize(uint32_t n) {
+        ready_queue.reserve(n);
+    }
+
+    void save(std::ostream& out) const {
+        ready_queue.save(out);
+    }
+
+    //back to what save() wrote, after resize() to the same n
+    bool load(std::istream& in, uint32_t /*n*/) {
+        return ready_queue.load(in);
+    }
+
+protected:
+    IndexQueue ready_queue;
+};
+
+//round robin, FCFS where a burst gets the CPU for at most one time slice
+class RrPolicy : public FcfsPolicy {
+public:
+    static const bool TIME_SLICED = true;
+
+    RrPolicy(uint32_t n, int tslice) : FcfsPolicy(n), tslice(tslice) {}
+
+    const char* name() const {
+        return "RR";
+    }
+
+    const char* end_queue() const {
+        return "[Q Empty]";
+    }
+
+    int run_length(uint32_t /*p*/, const BurstState& burst) const {
+        return std::min(tslice, burst.remaining);
+    }
+
+private:
+    int tslice;
+};
+
+//SJF, or SRT when PREEMPTIVE, ordering the ready queue by the predicted next
+//burst tau = alpha * last burst + (1 - alpha) * tau (starting at 1/lambda)
+template <bool PREEMPTIVE>
+class ShortestFirstPolicy : public PolicyBase {
+public:
+    ShortestFirstPolicy(uint32_t n, double lambda, double alpha) : ready_queue(n), tau(n, ceil(1 / lambda)), initial_tau(ceil(1 / lambda)), alpha(alpha) {}
+
+    const char* name() const {
+        return PREEMPTIVE ? "SRT" : "SJF";
+    }
+
+    bool empty() const {
+        return ready_queue.empty();
+    }
+
+    uint32_t size() const {
+        return ready_queue.size();
+    }
+
+    uint32_t front() const {
+        return ready_queue.front();
+    }
+
+    void pop() {
+        ready_queue.pop();
+    }
+
+    void arrived(uint32_t p) {
+        tau[p] = initial_tau;
+    }
+
+    void adopt(uint32_t p, const ShortestFirstPolicy& from) {
+        tau[p] = from.tau[p];
+    }
+
+    //SRT orders by predicted remaining time, which only shrinks while on the CPU
+    void push(uint32_t p, const BurstState& burst) {
+        ready_queue.push(p, PREEMPTIVE ? predicted(p, burst, burst.remaining) : tau[p]);
+    }
+
+    const ReadyHeap& queue() const {
+        return ready_queue;
+    }
+
+    void resize(uint32_t n) {
+        ready_queue.reserve(n);
+        tau.resize(n, initial_tau);
+    }
+
+    void save(std::ostream& out) const {
+        ready_queue.save(out);
+        put(out, tau);
+    }
+
+    bool load(std::istream& in, uint32_t n) {
+        return ready_queue.load(in, n) && get(in, tau);
+    }
+
+    void describe(TraceSink& trace, uint32_t p) const {
+        trace << " (tau " << tau[p] << "ms)";
+    }
+
+    int predicted(uint32_t p, const BurstState& burst, int left) const {
+        return tau[p] - (burst.original - left);
+    }
+
+    void describe_running(TraceSink& trace, uint32_t p, const BurstState& burst, int left) const {
+        trace << " (predicted remaining time " << predicted(p, burst, left) << "ms)";
+    }
+
+    bool beats(uint32_t p, const BurstState& burst, uint32_t running, const BurstState& running_burst, int left) const {
+        return PREEMPTIVE && predicted(p, burst, burst.remaining) < predicted(running, running_burst, left);
+    }
+
+    void burst_done(uint32_t p, int length, int now, TraceSink& trace, const Workload& processes) {
+        int old_tau = tau[p];
+        tau[p] = ceil(alpha * length + (1 - alpha) * old_tau);
+        if (trace.shows(now)) {
+            trace.line(now) << "Recalculated tau for process " << processes.id[p] << ": old tau " << old_tau
+                  << "ms ==> new tau " << tau[p] << "ms [Q";
+            print_queue(trace, ready_queue, processes);
+        }
+    }
+
+private:
+    ReadyHeap ready_queue;
+    std::vector<int> tau;
+    int initial_tau;
+    double alpha;
+};
+
+typedef ShortestFirstPolicy<false> SjfPolicy;
+typedef ShortestFirstPolicy<true> SrtPolicy;
+
+//multilevel feedback queue: a process starts in level 0 and drops a level each
+//time it uses up the quantum of its level, a level only runs while the ones
+//above it are empty and an arrival in a higher level preempts; every boost ms
+//(at the first event after) all processes go back to level 0 so long jobs do not starve
+class MlfqPolicy : public PolicyBase {
+public:
+    static const bool TIME_SLICED = true;
+
+    MlfqPolicy(uint32_t n, const std::vector<int>& quanta, int boost)
+        : ready_queue(n, quanta.size()), level(n, 0), boosted(n, 0), quanta(quanta), boost(boost), next_boost(boost), boosts(0),
+          run_boosts(n, 0) {}
+
+    const char* name() const {
+        return "MLFQ";
+    }
+
+    bool empty() const {
+        return ready_queue.empty();
+    }
+
+    uint32_t size() const {
+        return ready_queue.size();
+    }
+
+    uint32_t front() const {
+        return ready_queue.front();
+    }
+
+    void pop() {
+        ready_queue.pop();
+    }
+
+    void push(uint32_t p, const BurstState& /*burst*/) {
+        ready_queue.push(p, level_of(p));
+    }
+
+    void arrived(uint32_t p) {
+        level[p] = 0;
+    }
+
+    //the level p reached, counted from the boosts of this queue
+    void adopt(uint32_t p, const MlfqPolicy& from) {
+        level[p] = from.level_of(p);
+        boosted[p] = boosts;
+    }
+
+    const LevelQueue& queue() const {
+        return ready_queue;
+    }
+
+    void resize(uint32_t n) {
+        ready_queue.reserve(n);
+        level.resize(n, 0);
+        boosted.resize(n, 0);
+        run_boosts.resize(n, 0);
+    }
+
+    void save(std::ostream& out) const {
+        ready_queue.save(out);
+        put(out, level);
+        put(out, boosted);
+        put(out, run_boosts);
+        put(out, next_boost);
+        put(out, boosts);
+    }
+
+    bool load(std::istream& in, uint32_t /*n*/) {
+        if (!ready_queue.load(in) || !get(in, level) || !get(in, boosted) || !get(in, run_boosts) || !get(in, next_boost) || !get(in, boosts))
+            return false;
+        for (size_t p = 0; p < level.size(); p++) {
+            if (level[p] >= quanta.size())
+                return false;
+        }
+        return true;
+    }
+
+    void describe(TraceSink& trace, uint32_t p) const {
+        trace << " (level " << level_of(p) << ")";
+    }
+
+    void advance(int now, TraceSink& trace, const Workload& processes) {
+        if (boost <= 0 || now < next_boost)
+            return;
+        ready_queue.merge();
+        boosts++;
+        next_boost = (now / boost + 1) * boost;
+        if (trace.shows(now)) {
+            trace.line(now) << "Priority boost; all processes moved to level 0 [Q";
+            print_queue(trace, ready_queue, processes);
+        }
+    }
+
+    int run_length(uint32_t p, const BurstState& burst) {
+        run_boosts[p] = boosts;
+        return std::min(quanta[level_of(p)], burst.remaining);
+    }
+
+    //a boost during the run resets the level without the quantum counting against it
+    void charge(uint32_t p, int ms) {
+        uint32_t current = level_of(p);
+        if (boosts == run_boosts[p] && ms >= quanta[current] && current + 1 < quanta.size()) {
+            level[p] = current + 1;
+            boosted[p] = boosts;
+        }
+    }
+
+    bool beats(uint32_t p, const BurstState& /*burst*/, uint32_t running, const BurstState& /*running_burst*/, int /*left*/) const {
+        return level_of(p) < level_of(running);
+    }
+
+private:
+    //a boost bumps the count instead of touching every process, a level set
+    //before the latest boost is back to 0
+    uint32_t level_of(uint32_t p) const {
+        return boosted[p] == boosts ? level[p] : 0;
+    }
+
+    LevelQueue ready_queue;
+    std::vector<uint32_t> level;
+    std::vector<uint32_t> boosted; //boosts when level was set
+    std::vector<int> quanta;
+    int boost;
+    int next_boost;
+    uint32_t boosts;
+    std::vector<uint32_t> run_boosts; //boosts when the current run of each process started
+};
+
+//completely fair scheduling: the ready queue is ordered by virtual runtime, the
+//CPU time a process has had, and a run lasts latency split over the runnable
+//processes (at least granularity); a waking process gets at most latency/2 of
+//credit over the least vruntime so far, and preempts when that is more than granularity
+//behind the running one (all processes weigh the same, there are no priorities)
+class CfsPolicy : public PolicyBase {
+public:
+    static const bool TIME_SLICED = true;
+
+    CfsPolicy(uint32_t n, int latency, int granularity)
+        : ready_queue(n), vruntime(n, 0), min_vruntime(0), latency(latency), granularity(granularity), slice(n, 0) {}
+
+    const char* name() const {
+        return "CFS";
+    }
+
+    bool empty() const {
+        return ready_queue.empty();
+    }
+
+    uint32_t size() const {
+        return ready_queue.size();
+    }
+
+    uint32_t front() const {
+        return ready_queue.front();
+    }
+
+    void pop() {
+        ready_queue.pop();
+    }
+
+    void arrived(uint32_t p) {
+        vruntime[p] = 0;
+    }
+
+    //vruntime is kept relative to the least vruntime of the queue it moves between
+    void adopt(uint32_t p, const CfsPolicy& from) {
+        vruntime[p] = from.vruntime[p] - from.min_vruntime + min_vruntime;
+    }
+
+    void push(uint32_t p, const BurstState& /*burst*/) {
+        vruntime[p] = placed(p);
+        ready_queue.push(p, vruntime[p]);
+    }
+
+    const ReadyHeap& queue() const {
+        return ready_queue;
+    }
+
+    void resize(uint32_t n) {
+        ready_queue.reserve(n);
+        vruntime.resize(n, 0);
+        slice.resize(n, 0);
+    }
+
+    void save(std::ostream& out) const {
+        ready_queue.save(out);
+        put(out, vruntime);
+        put(out, min_vruntime);
+        put(out, slice);
+    }
+
+    bool load(std::istream& in, uint32_t n) {
+        return ready_queue.load(in, n) && get(in, vruntime) && get(in, min_vruntime) && get(in, slice);
+    }
+
+    void describe(TraceSink& trace, uint32_t p) const {
+        trace << " (vruntime " << vruntime[p] << "ms)";
+    }
+
+    void describe_running(TraceSink& trace, uint32_t p, const BurstState& /*burst*/, int left) const {
+        trace << " (vruntime " << vruntime[p] + slice[p] - left << "ms)";
+    }
+
+    int run_length(uint32_t p, const BurstState& burst) {
+        slice[p] = std::min(std::max(granularity, latency / (int)(ready_queue.size() + 1)), burst.remaining);
+        return slice[p];
+    }
+
+    void charge(uint32_t p, int ms) {
+        vruntime[p] += ms;
+        int least = ready_queue.empty() ? vruntime[p] : std::min(vruntime[p], ready_queue.front_key());
+        min_vruntime = std::max(min_vruntime, least);
+    }
+
+    bool yields(uint32_t p) const {
+        return ready_queue.front_key() < vruntime[p];
+    }
+
+    bool beats(uint32_t p, const BurstState& /*burst*/, uint32_t running, const BurstState& /*running_burst*/, int left) const {
+        return placed(p) + granularity < vruntime[running] + slice[running] - left;
+    }
+
+private:
+    //vruntime of p once it is back in the ready queue
+    int placed(uint32_t p) const {
+        return std::max(vruntime[p], min_vruntime - latency / 2);
+    }
+
+    ReadyHeap ready_queue;
+    std::vector<int> vruntime;
+    int min_vruntime;
+    int latency;
+    int granularity;
+    std::vector<int> slice; //length of the current run of each process
+};
+
+//the single-CPU simulation, every algorithm is this event loop run with the
+//rules of its policy class (see PolicyBase)
+template <typename SchedulerPolicy>
+SimSummary simulate(const Workload& processes, int tcs, SchedulerPolicy& policy, TraceSink& trace) {
+    uint32_t n = processes.size();
+    IoQueue io_queue(n);
+    uint32_t next_arrival = 0; //cursor into processes.arrival_order
+    std::vector<uint32_t> burst_index(n, 0);
+    std::vector<BurstState> bursts = first_bursts(processes);
+    int current_time = 0;
+    bool printInitial = true;
+    uint32_t current_process = 0;
+    int switch_done_time = 0; //time the current context switch completes
+    int done_time = 0;
+    bool has_current_process = false;
+    bool contextSwitching = false;
+    bool preempt = false; //a ready process takes the CPU from the running one
+    int slice = 0;        //length of the current run
+    EventQueue events;
+    SimStats stats(processes);
+
+    auto beats_running = [&](uint32_t p) {
+        return has_current_process && !contextSwitching && !preempt && done_time > current_time
+               && policy.beats(p, bursts[p], current_process, bursts[current_process], done_time - current_time);
+    };
+    auto print_preempting = [&]() {
+        trace << "preempting " << processes.id[current_process];
+        policy.describe_running(trace, current_process, bursts[current_process], done_time - current_time);
+        trace << " [Q";
+    };
+    //the process leaving the CPU takes the first half of a context switch
+    auto record_switch_out = [&]() {
+        trace.record(EVENT_SWITCH_BEGIN, current_time, current_process, 0, 1);
+        trace.record(EVENT_SWITCH_END, current_time + tcs / 2, current_process, 0, 1);
+    };
+
+    if (n > 0) {
+        events.schedule(processes.arrival_time[processes.arrival_order[0]]);
+    }
+
+    //check if any processes arrive at time 0
+    while (next_arrival < n && processes.arrival_time[processes.arrival_order[next_arrival]] == 0) {
+        uint32_t p = processes.arrival_order[next_arrival++];
+        policy.push(p, bursts[p]);
+        stats.ready(p, current_time);
+        trace.record(EVENT_ARRIVAL, current_time, p, 0, bursts[p].original);
+        trace << "time 0ms: Process " << processes.id[p];
+        policy.describe(trace, p);
+        trace << " arrived; added to ready queue [Q";
+        print_queue(trace, policy.queue(), processes);
+        if (next_arrival < n) {
+            events.schedule(processes.arrival_time[processes.arrival_order[next_arrival]]);
+        }
+        printInitial = false;
+    }
+
+    if (printInitial) {
+        trace << "time 0ms: Simulator started for " << policy.name() << " [Q empty]" << '\n';
+        current_time = events.first_time();
+    }
+
+    while ((next_arrival < n || !policy.empty() || !io_queue.empty() || has_current_process)) {
+        policy.advance(current_time, trace, processes);
+
+        //check if any processes arrive
+        while (next_arrival < n && processes.arrival_time[processes.arrival_order[next_arrival]] <= current_time) {
+            uint32_t p = processes.arrival_order[next_arrival++];
+            bool preempting = beats_running(p);
+            policy.push(p, bursts[p]);
+            stats.ready(p, current_time);
+            trace.record(EVENT_ARRIVAL, current_time, p, 0, bursts[p].original);
+            trace << "time " << current_time << "ms: Process " << processes.id[p];
+            policy.describe(trace, p);
+            trace << " arrived; ";
+            if (preempting) {
+                print_preempting();
+                preempt = true;
+            } else {
+                trace << "added to ready queue [Q";
+            }
+            print_queue(trace, policy.queue(), processes);
+            if (next_arrival < n) {
+                events.schedule(processes.arrival_time[processes.arrival_order[next_arrival]]);
+            }
+        }
+
+        //check if any processes are done with IO
+        while (io_queue.due(current_time)) {
+            uint32_t p = io_queue.pop();
+            bool preempting = beats_running(p);
+            policy.push(p, bursts[p]);
+            stats.ready(p, current_time);
+            trace.record(EVENT_IO_DONE, current_time, p, 0, 0);
+            if (preempting || trace.shows(current_time)) {
+                trace << "time " << current_time << "ms: Process " << processes.id[p];
+                policy.describe(trace, p);
+                trace << " completed I/O; ";
+                if (preempting) {
+                    print_preempting();
+                    preempt = true;
+                } else {
+                    trace << "added to ready queue [Q";
+                }
+                print_queue(trace, policy.queue(), processes);
+            }
+        }
+
+        //check if CPU is idle
+        if (!has_current_process && policy.empty()) {
+            current_time = events.advance(current_time);
+            continue;
+        }
+
+        if (contextSwitching) {
+            if (switch_done_time <= current_time && (has_current_process || SchedulerPolicy::BASELINE_TRACE)) {
+                const BurstState& burst = bursts[current_process];
+                if (trace.shows(current_time)) {
+                    trace << "time " << current_time << "ms: Process " << processes.id[current_process];
+                    policy.describe(trace, current_process);
+                    trace << " started using the CPU for ";
+                    //a burst that was cut short before shows what is left of it
+                    if (burst.preempted) {
+                        trace << "remaining " << burst.remaining << "ms of " << burst.original << "ms burst [Q";
+                    } else {
+                        trace << burst.remaining << "ms burst [Q";
+                    }
+                    print_queue(trace, policy.queue(), processes);
+                }
+                slice = policy.run_length(current_process, burst);
+                done_time = current_time + slice;
+                //a stale start line (CPU left idle after a switch out) has nothing to finish
+                if (has_current_process) {
+                    events.schedule(done_time);
+                    trace.record(EVENT_SWITCH_END, current_time, current_process, 0, 0);
+                    trace.record(EVENT_DISPATCH, current_time, current_process, 0, burst.remaining);
+                }
+                contextSwitching = false;
+
+                //something that arrived during the switch may already beat it
+                if (has_current_process && !policy.empty() && beats_running(policy.front())) {
+                    trace << "time " << current_time << "ms: Process " << processes.id[policy.front()];
+                    policy.describe(trace, policy.front());
+                    trace << " will preempt " << processes.id[current_process] << " [Q";
+                    print_queue(trace, policy.queue(), processes);
+                    preempt = true;
+                }
+            } else if (switch_done_time <= current_time) {
+                //a switch out that left the CPU idle is simply over
+                contextSwitching = false;
+            } else {
+                current_time = events.advance(current_time);
+                continue;
+            }
+        }
+
+        //handle the current process in the CPU
+        if (has_current_process) {
+            BurstState& state = bursts[current_process];
+            if (done_time == current_time) {
+                uint32_t burst = processes.first_burst[current_process] + burst_index[current_process];
+                uint32_t num_bursts = processes.num_bursts[current_process];
+                policy.charge(current_process, slice);
+                stats.ran(0, slice);
+
+                if (state.remaining > slice) {
+                    //time slice expired
+                    state.remaining -= slice;
+                    state.preempted = true;
+                    if (policy.empty() || !policy.yields(current_process)) {
+                        slice = policy.run_length(current_process, state);
+                        done_time = current_time + slice;
+                        events.schedule(done_time);
+                        if (policy.empty()) {
+                            trace << "time " << current_time << "ms: Time slice expired; no preemption because ready queue is empty [Q empty]" << '\n';
+                        } else if (trace.shows(current_time)) {
+                            trace << "time " << current_time << "ms: Time slice expired; no preemption because " << processes.id[current_process] << " still comes first [Q";
+                            print_queue(trace, policy.queue(), processes);
+                        }
+                        current_time = events.advance(current_time);
+                        continue;
+                    }
+                    if (trace.shows(current_time)) {
+                        trace << "time " << current_time << "ms: Time slice expired; preempting process " << processes.id[current_process] << " with "
+                              << state.remaining << "ms remaining [Q";
+                        print_queue(trace, policy.queue(), processes);
+                    }
+                    trace.record(EVENT_PREEMPT, current_time, current_process, 0, state.remaining);
+                    policy.push(current_process, state);
+                    stats.requeued(current_process, current_time);
+                } else {
+                    trace.record(EVENT_BURST_DONE, current_time, current_process, 0, state.original);
+                    stats.burst_done(current_process, state.original, current_time + tcs / 2, SchedulerPolicy::TIME_SLICED && !state.preempted);
+                    if (burst_index[current_process] < num_bursts - 1) {
+                        int io_time = processes.io_bursts[burst];
+                        burst_index[current_process]++;
+                        io_queue.push(current_time + io_time + tcs / 2, current_process);
+                        events.schedule(current_time + io_time + tcs / 2);
+                        trace.record(EVENT_IO_BLOCK, current_time, current_process, 0, current_time + io_time + tcs / 2);
+                        if (trace.shows(current_time)) {
+                            trace << "time " << current_time << "ms: Process " << processes.id[current_process];
+                            policy.describe(trace, current_process);
+                            uint32_t to_go = num_bursts - burst_index[current_process];
+                            trace << " completed a CPU burst; " << to_go << (to_go == 1 && !SchedulerPolicy::BASELINE_TRACE ? " burst" : " bursts")
+                                  << " to go [Q";
+                            print_queue(trace, policy.queue(), processes);
+                        }
+                        policy.burst_done(current_process, state.original, current_time, trace, processes);
+                        state.start(processes.cpu_bursts[burst + 1]);
+                        if (trace.shows(current_time)) {
+                            trace << "time " << current_time << "ms: Process " << processes.id[current_process] << " switching out of CPU; blocking on I/O until time "
+                                  << current_time + io_time + tcs / 2 << "ms [Q";
+                            print_queue(trace, policy.queue(), processes);
+                        }
+                    } else {
+                        trace.record(EVENT_TERMINATE, current_time, current_process, 0, 0);
+                        trace << "time " << current_time << "ms: Process " << processes.id[current_process] << " terminated [Q";
+                        print_queue(trace, policy.queue(), processes);
+                    }
+                }
+                record_switch_out();
+                contextSwitching = true;
+                has_current_process = false;
+            } else if (preempt) {
+                int ran = slice - (done_time - current_time);
+                policy.charge(current_process, ran);
+                stats.ran(0, ran);
+                state.remaining -= ran;
+                //preempted the moment it started, it has not lost any of its burst yet
+                state.preempted = state.remaining < state.original;
+                trace.record(EVENT_PREEMPT, current_time, current_process, 0, state.remaining);
+                policy.push(current_process, state);
+                stats.requeued(current_process, current_time);
+                record_switch_out();
+                contextSwitching = true;
+                has_current_process = false;
+            }
+            preempt = false;
+        }
+
+        //process the next process in ready queue
+        if ((!has_current_process && !policy.empty())) {
+            current_process = policy.front();
+            policy.pop();
+            has_current_process = true;
+            switch_done_time = current_time + tcs / 2;
+            if (contextSwitching) {
+                switch_done_time += tcs / 2;
+            } else {
+                contextSwitching = true;
+            }
+            events.schedule(switch_done_time);
+            stats.switch_in(current_process, switch_done_time - tcs / 2);
+            trace.record(EVENT_SWITCH_BEGIN, switch_done_time - tcs / 2, current_process, 0, 0);
+        }
+
+        current_time = events.advance(current_time);
+    }
+    trace << "time " << current_time + tcs / 2 - 1 << "ms: Simulator ended for " << policy.name() << " " << policy.end_queue() << '\n';
+    return stats.summary(current_time + tcs / 2 - 1, SchedulerPolicy::TIME_SLICED, events.count());
+}
+
+//scheduling algorithms, in the order the simulators run
+enum Policy {
+    POLICY_FCFS,
+    POLICY_SJF,
+    POLICY_SRT,
+    POLICY_RR,
+    POLICY_MLFQ,
+    POLICY_CFS
+};
+
+const char* policy_name(Policy policy) {
+    static const char* names[] = {"FCFS", "SJF", "SRT", "RR", "MLFQ", "CFS"};
+    return names[policy];
+}
+
+//settings of the policies that only run when asked for
+struct PolicyOptions {
+    std::vector<int> quanta; //MLFQ quantum of each level, level 0 first
+    int boost;               //MLFQ priority boost period in ms, 0 for none
+    int latency;             //CFS target latency in ms
+    int granularity;         //CFS shortest run in ms
+
+    PolicyOptions() : quanta({8, 16, 32}), boost(0), latency(24), granularity(3) {}
+};
+
+//one CPU of the SMP simulation
+struct Core {
+    enum State { IDLE, SWITCH_IN, RUNNING, SWITCH_OUT };
+
+    State state;
+    uint32_t process;
+    int until;     //end of the current context switch or CPU run
+    int run_start; //start of the current CPU run
+    bool preempt;  //a ready process is predicted to finish before this one
+
+    Core() : state(IDLE), process(0), until(0), run_start(0), preempt(false) {}
+};
+
+//the multi-CPU event loop: cores CPUs, each with its own context switch state,
+//sharing one global ready queue or with a ready queue per core (processes go
+//back to the core they last ran on and idle cores steal from the longest
+//queue); each ready queue is its own instance of SchedulerPolicy and a stolen
+//process's policy state goes with it (see adopt()); the caller drives the clock:
+//set_time(), then arrive() for every arrival, then settle()
+template <typename SchedulerPolicy>
+class SmpScheduler {
+public:
+    SmpScheduler(const Workload& processes, const SchedulerPolicy& policy, int cores, bool per_core, int tcs, TraceSink& trace)
+        : processes(processes), trace(trace), per_core(per_core), tcs(tcs), cpu(cores), queues(per_core ? cores : 1, policy),
+          io_queue(processes.size()), burst_index(processes.size(), 0), bursts(processes.size()), last_core(processes.size(), -1),
+          stats(processes, cores), exits(nullptr), terminated(0), current_time(0) {
+        for (int c = 0; c < cores; c++)
+            tags.push_back("[CPU " + std::to_string(c) + "] ");
+    }
+
+    //the clock moves on to now, the policies see it before anything happens then
+    void set_time(int now) {
+        current_time = now;
+        for (size_t q = 0; q < queues.size(); q++) {
+            trace.set_tag(per_core ? tags[q].c_str() : "");
+            queues[q].advance(now, trace, processes);
+        }
+        trace.set_tag("");
+    }
+
+    //p arrives now as a new process, on its first CPU burst
+    void arrive(uint32_t p) {
+        burst_index[p] = 0;
+        bursts[p].start(processes.cpu_bursts[processes.first_burst[p]]);
+        last_core[p] = -1;
+        make_ready(p, EVENT_ARRIVAL, "arrived", false);
+    }
+
+    //I/O completions by now, then every core as far as it gets
+    void settle() {
+        while (io_queue.due(current_time))
+            make_ready(io_queue.pop(), EVENT_IO_DONE, "completed I/O", true);
+        //zero length switches can let a core go through several states at once
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int c = 0; c < cores(); c++)
+                changed = step(c) || changed;
+            for (int c = 0; c < cores(); c++)
+                changed = dispatch(c) || changed;
+        }
+    }
+
+    void schedule(int time) {
+        events.schedule(time);
+    }
+
+    //drops everything up to the current time and returns the next event time
+    int advance() {
+        return events.advance(current_time);
+    }
+
+    bool idle() const {
+        for (int c = 0; c < cores(); c++) {
+            if (cpu[c].state != Core::IDLE)
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t terminations() const {
+        return terminated;
+    }
+
+    //terminated processes get appended to list, so their indices can be reused
+    void exit_to(std::vector<uint32_t>* list) {
+        exits = list;
+    }
+
+    SimSummary summary(int end_time) const {
+        return stats.summary(end_time, SchedulerPolicy::TIME_SLICED, events.count());
+    }
+
+    //room for processes up to n, once the workload has grown to n
+    void resize(uint32_t n) {
+        for (size_t q = 0; q < queues.size(); q++)
+            queues[q].resize(n);
+        burst_index.resize(n, 0);
+        bursts.resize(n);
+        last_core.resize(n, -1);
+        stats.resize(n);
+    }
+
+    //everything but the workload and the clock, for a checkpoint of a streaming run
+    void save(std::ostream& out) const {
+        put(out, cpu);
+        for (size_t q = 0; q < queues.size(); q++)
+            queues[q].save(out);
+        io_queue.save(out);
+        put(out, burst_index);
+        put(out, bursts);
+        put(out, last_core);
+        events.save(out);
+        stats.save(out);
+        put(out, terminated);
+    }
+
+    //back to what save() wrote, after resize() to the same number of processes
+    bool load(std::istream& in) {
+        uint32_t n = burst_index.size();
+        if (!get(in, cpu))
+            return false;
+        for (int c = 0; c < cores(); c++) {
+            if (cpu[c].state != Core::IDLE && cpu[c].process >= n)
+                return false;
+        }
+        for (size_t q = 0; q < queues.size(); q++) {
+            if (!queues[q].load(in, n))
+                return false;
+        }
+        return io_queue.load(in, n) && get(in, burst_index) && get(in, bursts) && get(in, last_core) && events.load(in) && stats.load(in)
+               && get(in, terminated);
+    }
+
+private:
+    int cores() const {
+        return cpu.size();
+    }
+
+    int queue_of(int core) const {
+        return per_core ? core : 0;
+    }
+
+    //events on a queue are tagged with its core when every core has its own
+    void queue_tag(int q) {
+        trace << "time " << current_time << "ms: ";
+        if (per_core)
+            trace << tags[q];
+    }
+
+    void core_tag(int core) {
+        trace << "time " << current_time << "ms: " << tags[core];
+    }
+
+    //p with what the policy of queue q shows about it
+    void process_name(int q, uint32_t p) {
+        trace << "Process " << processes.id[p];
+        queues[q].describe(trace, p);
+    }
+
+    //queue for a process that just became ready, its last core or else the least loaded one
+    int place(uint32_t p) const {
+        if (!per_core)
+            return 0;
+        if (last_core[p] >= 0)
+            return last_core[p];
+        int best = 0;
+        uint32_t best_load = 0;
+        for (int c = 0; c < cores(); c++) {
+            uint32_t load = queues[c].size() + (cpu[c].state != Core::IDLE ? 1 : 0);
+            if (c == 0 || load < best_load) {
+                best = c;
+                best_load = load;
+            }
+        }
+        return best;
+    }
+
+    //the core of queue q whose process p should preempt, -1 for none; of
+    //several, the one whose process the others would preempt in turn
+    int preempt_target(uint32_t p, int q) const {
+        const SchedulerPolicy& policy = queues[q];
+        int target = -1;
+        BurstState target_burst; //the target's burst as it would go back to the queue
+        for (int c = 0; c < cores(); c++) {
+            const Core& core = cpu[c];
+            if (queue_of(c) != q || core.state != Core::RUNNING || core.preempt || core.until <= current_time)
+                continue;
+            uint32_t running = core.process;
+            int left = core.until - current_time;
+            if (!policy.beats(p, bursts[p], running, bursts[running], left))
+                continue;
+            if (target < 0 || policy.beats(cpu[target].process, target_burst, running, bursts[running], left)) {
+                target = c;
+                target_burst = bursts[running];
+                target_burst.remaining -= current_time - core.run_start;
+            }
+        }
+        return target;
+    }
+
+    void make_ready(uint32_t p, TelemetryKind kind, const char* event, bool gated) {
+        int q = place(p);
+        if (kind == EVENT_ARRIVAL)
+            queues[q].arrived(p);
+        int target = preempt_target(p, q);
+        queues[q].push(p, bursts[p]);
+        stats.ready(p, current_time);
+        trace.record(kind, current_time, p, q, kind == EVENT_ARRIVAL ? bursts[p].original : 0);
+        if (target >= 0) {
+            const Core& core = cpu[target];
+            cpu[target].preempt = true;
+            queue_tag(q);
+            process_name(q, p);
+            trace << " " << event << "; preempting " << processes.id[core.process] << " on CPU " << target;
+            queues[q].describe_running(trace, core.process, bursts[core.process], core.until - current_time);
+            trace << " [Q";
+            print_queue(trace, queues[q].queue(), processes);
+        } else if (!gated || trace.shows(current_time)) {
+            queue_tag(q);
+            process_name(q, p);
+            trace << " " << event << "; added to ready queue [Q";
+            print_queue(trace, queues[q].queue(), processes);
+        }
+    }
+
+    void switch_out(int c) {
+        Core& core = cpu[c];
+        trace.record(EVENT_SWITCH_BEGIN, current_time, core.process, c, 1);
+        core.state = Core::SWITCH_OUT;
+        core.until = current_time + tcs / 2;
+        core.preempt = false;
+        events.schedule(core.until);
+    }
+
+    //the run on core c ends now, what it ran is charged to the burst and the policy
+    void stop_run(int c) {
+        Core& core = cpu[c];
+        BurstState& burst = bursts[core.process];
+        int ran = current_time - core.run_start;
+        burst.remaining -= ran;
+        if (burst.remaining > 0 && ran > 0)
+            burst.preempted = true;
+        stats.ran(c, ran);
+        queues[queue_of(c)].charge(core.process, ran);
+    }
+
+    //advances one core as far as it gets at current_time, true if it changed state
+    bool step(int c) {
+        Core& core = cpu[c];
+        int q = queue_of(c);
+        SchedulerPolicy& policy = queues[q];
+        uint32_t p = core.process;
+        if (core.state == Core::SWITCH_OUT && core.until <= current_time) {
+            trace.record(EVENT_SWITCH_END, current_time, p, c, 1);
+            core.state = Core::IDLE;
+            return true;
+        }
+        if (core.state == Core::SWITCH_IN && core.until <= current_time) {
+            BurstState& burst = bursts[p];
+            if (trace.shows(current_time)) {
+                core_tag(c);
+                process_name(q, p);
+                trace << " started using the CPU for ";
+                if (burst.preempted)
+                    trace << "remaining " << burst.remaining << "ms of ";
+                trace << burst.original << "ms burst [Q";
+                print_queue(trace, policy.queue(), processes);
+            }
+            int run = policy.run_length(p, burst);
+            core.state = Core::RUNNING;
+            core.run_start = current_time;
+            core.until = current_time + run;
+            events.schedule(core.until);
+            trace.record(EVENT_SWITCH_END, current_time, p, c, 0);
+            trace.record(EVENT_DISPATCH, current_time, p, c, burst.remaining);
+            //something that became ready during the switch may already beat it
+            if (!policy.empty() && policy.beats(policy.front(), bursts[policy.front()], p, burst, run)) {
+                core_tag(c);
+                process_name(q, policy.front());
+                trace << " will preempt " << processes.id[p] << " [Q";
+                print_queue(trace, policy.queue(), processes);
+                core.preempt = true;
+            }
+            return true;
+        }
+        if (core.state != Core::RUNNING)
+            return false;
+
+        BurstState& state = bursts[p];
+        if (core.until == current_time) {
+            stop_run(c);
+            if (state.remaining > 0) {
+                //time slice expired
+                if (policy.empty() || !policy.yields(p)) {
+                    core.run_start = current_time;
+                    core.until = current_time + policy.run_length(p, state);
+                    events.schedule(core.until);
+                    if (policy.empty()) {
+                        core_tag(c);
+                        trace << "Time slice expired; no preemption because ready queue is empty [Q empty]\n";
+                    } else if (trace.shows(current_time)) {
+                        core_tag(c);
+                        trace << "Time slice expired; no preemption because " << processes.id[p] << " still comes first [Q";
+                        print_queue(trace, policy.queue(), processes);
+                    }
+                    return false;
+                }
+                if (trace.shows(current_time)) {
+                    core_tag(c);
+                    trace << "Time slice expired; preempting process " << processes.id[p] << " with " << state.remaining << "ms remaining [Q";
+                    print_queue(trace, policy.queue(), processes);
+                }
+                trace.record(EVENT_PREEMPT, current_time, p, c, state.remaining);
+                policy.push(p, state);
+                stats.requeued(p, current_time);
+                switch_out(c);
+                return true;
+            }
+
+            uint32_t num_bursts = processes.num_bursts[p];
+            trace.record(EVENT_BURST_DONE, current_time, p, c, state.original);
+            stats.burst_done(p, state.original, current_time + tcs / 2, SchedulerPolicy::TIME_SLICED && !state.preempted);
+            if (burst_index[p] < num_bursts - 1) {
+                uint32_t burst = processes.first_burst[p] + burst_index[p];
+                int io_done = current_time + processes.io_bursts[burst] + tcs / 2;
+                burst_index[p]++;
+                io_queue.push(io_done, p);
+                events.schedule(io_done);
+                trace.record(EVENT_IO_BLOCK, current_time, p, c, io_done);
+                if (trace.shows(current_time)) {
+                    uint32_t to_go = num_bursts - burst_index[p];
+                    core_tag(c);
+                    process_name(q, p);
+                    trace << " completed a CPU burst; " << to_go << (to_go == 1 ? " burst" : " bursts") << " to go [Q";
+                    print_queue(trace, policy.queue(), processes);
+                }
+                trace.set_tag(tags[c].c_str());
+                policy.burst_done(p, state.original, current_time, trace, processes);
+                trace.set_tag("");
+                state.start(processes.cpu_bursts[burst + 1]);
+                if (trace.shows(current_time)) {
+                    core_tag(c);
+                    trace << "Process " << processes.id[p] << " switching out of CPU; blocking on I/O until time " << io_done << "ms [Q";
+                    print_queue(trace, policy.queue(), processes);
+                }
+            } else {
+                terminated++;
+                if (exits)
+                    exits->push_back(p);
+                trace.record(EVENT_TERMINATE, current_time, p, c, 0);
+                core_tag(c);
+                trace << "Process " << processes.id[p] << " terminated [Q";
+                print_queue(trace, policy.queue(), processes);
+            }
+            switch_out(c);
+            return true;
+        }
+
+        if (core.preempt) {
+            stop_run(c);
+            trace.record(EVENT_PREEMPT, current_time, p, c, state.remaining);
+            policy.push(p, state);
+            stats.requeued(p, current_time);
+            switch_out(c);
+            return true;
+        }
+        return false;
+    }
+
+    //an idle core takes the next process of its queue, or steals one
+    bool dispatch(int c) {
+        Core& core = cpu[c];
+        int q = queue_of(c);
+        if (core.state != Core::IDLE)
+            return false;
+        if (queues[q].empty() && per_core) {
+            int victim = -1;
+            for (int v = 0; v < cores(); v++) {
+                if (v != c && !queues[v].empty() && (victim < 0 || queues[v].size() > queues[victim].size()))
+                    victim = v;
+            }
+            if (victim < 0)
+                return false;
+            q = victim;
+        }
+        if (queues[q].empty())
+            return false;
+        uint32_t p = queues[q].front();
+        queues[q].pop();
+        if (q != queue_of(c)) {
+            queues[queue_of(c)].adopt(p, queues[q]);
+            if (trace.shows(current_time)) {
+                core_tag(c);
+                trace << "Process " << processes.id[p] << " stolen from CPU " << q << " [Q";
+                print_queue(trace, queues[q].queue(), processes);
+            }
+        }
+        core.state = Core::SWITCH_IN;
+        core.process = p;
+        core.until = current_time + tcs / 2;
+        events.schedule(core.until);
+        stats.switch_in(p, current_time);
+        trace.record(EVENT_SWITCH_BEGIN, current_time, p, c, 0);
+        if (last_core[p] >= 0 && last_core[p] != c)
+            stats.migrated(p);
+        last_core[p] = c;
+        return true;
+    }
+
+    const Workload& processes;
+    TraceSink& trace;
+    bool per_core;
+    int tcs;
+    std::vector<Core> cpu;
+    std::vector<SchedulerPolicy> queues; //one per core, or the one global queue
+    std::vector<std::string> tags;       //"[CPU c] " of each core
+    IoQueue io_queue;
+    std::vector<uint32_t> burst_index;
+    std::vector<BurstState> bursts;
+    std::vector<int> last_core;
+    EventQueue events;
+    SimStats stats;
+    std::vector<uint32_t>* exits;
+    uint64_t terminated;
+    int current_time;
+};
+
+//any of the algorithms on cores CPUs, the whole workload through an SmpScheduler
+template <typename SchedulerPolicy>
+SimSummary simulate_smp(const Workload& processes, int cores, bool per_core, int tcs, const SchedulerPolicy& policy, TraceSink& trace) {
+    uint32_t n = processes.size();
+    SmpScheduler<SchedulerPolicy> scheduler(processes, policy, cores, per_core, tcs, trace);
+    uint32_t next_arrival = 0;
+    int current_time = 0;
+
+    trace << "time 0ms: Simulator started for " << policy.name() << " on " << cores << " CPUs [Q empty]" << '\n';
+    if (n > 0) {
+        scheduler.schedule(processes.arrival_time[processes.arrival_order[0]]);
+    }
+
+    while (true) {
+        scheduler.set_time(current_time);
+
+        //check if any processes arrive
+        while (next_arrival < n && processes.arrival_time[processes.arrival_order[next_arrival]] <= current_time) {
+            scheduler.arrive(processes.arrival_order[next_arrival++]);
+            if (next_arrival < n) {
+                scheduler.schedule(processes.arrival_time[processes.arrival_order[next_arrival]]);
+            }
+        }
+
+        scheduler.settle();
+        if (scheduler.terminations() == n && scheduler.idle())
+            break;
+        current_time = scheduler.advance();
+    }
+    trace << "time " << current_time << "ms: Simulator ended for " << policy.name() << " [Q empty]" << '\n';
+    return scheduler.summary(current_time);
+}
+
+//whether the processes of a finished run got exactly the CPU time of their
+//bursts, none lost or run twice by preemptions; reports it if not
+bool check_run_time(const Workload& processes, const SimSummary& summary, Policy policy) {
+    double total = 0;
+    for (uint32_t p = 0; p < processes.size(); p++) {
+        for (uint32_t k = 0; k < processes.num_bursts[p]; k++)
+            total += processes.cpu_bursts[processes.first_burst[p] + k];
+    }
+    if (summary.run_time == total)
+        return true;
+    std::cerr << "ERROR: <" << policy_name(policy) << " ran processes for " << (long long)summary.run_time << "ms of their " << (long long)total
+              << "ms of CPU bursts>" << std::endl;
+    return false;
+}
+
+//one algorithm on the workload, through the single-core simulators unless
+//there is more than one CPU
+SimSummary run_policy(const Workload& processes, Policy policy, int cores, bool per_core, int tcs, double lambda, double alpha, int tslice,
+                      const PolicyOptions& options, TraceSink& trace) {
+    auto run = [&](auto& rules) {
+        if (cores > 1)
+            return simulate_smp(processes, cores, per_core, tcs, rules, trace);
+        return simulate(processes, tcs, rules, trace);
+    };
+    if (policy == POLICY_FCFS) {
+        FcfsPolicy rules(processes.size());
+        return run(rules);
+    }
+    if (policy == POLICY_SJF) {
+        SjfPolicy rules(processes.size(), lambda, alpha);
+        return run(rules);
+    }
+    if (policy == POLICY_SRT) {
+        SrtPolicy rules(processes.size(), lambda, alpha);
+        return run(rules);
+    }
+    if (policy == POLICY_MLFQ) {
+        MlfqPolicy rules(processes.size(), options.quanta, options.boost);
+        return run(rules);
+    }
+    if (policy == POLICY_CFS) {
+        CfsPolicy rules(processes.size(), options.latency, options.granularity);
+        return run(rules);
+    }
+    RrPolicy rules(processes.size(), tslice);
+    return run(rules);
+}
+
+//settings of a streaming run, kept in its checkpoints
+struct StreamConfig {
+    int policy;          //Policy, FCFS, SJF, SRT or RR
+    int tcs;
+    double alpha;
+    double lambda;
+    int bound;
+    int tslice;
+    double cpu_share;    //chance that an arriving process is CPU-bound
+    double interarrival; //mean ms between arrivals
+    int horizon;         //simulated ms to run for
+};
+
+//room for bursts in each process slot of a streaming run
+static const uint32_t STREAM_MAX_BURSTS = 32;
+
+//checkpoint files start with this header, then the StreamConfig, the clock and
+//random state, the process slots and the scheduler state (SmpScheduler::save)
+struct CheckpointHeader {
+    char magic[8]; //"OPSYSCP1"
+    uint32_t version;
+    uint32_t max_bursts; //STREAM_MAX_BURSTS
+};
+
+static const char CHECKPOINT_MAGIC[8] = {'O', 'P', 'S', 'Y', 'S', 'C', 'P', '1'};
+static const uint32_t CHECKPOINT_VERSION = 2;
+
+//reads the config of a checkpoint in, for constructing the simulator to load() into
+bool read_checkpoint_config(std::istream& in, StreamConfig& config, std::string& error) {
+    CheckpointHeader header;
+    if (!get(in, header) || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a checkpoint file";
+        return false;
+    }
+    if (header.version != CHECKPOINT_VERSION || header.max_bursts != STREAM_MAX_BURSTS) {
+        error = "unsupported checkpoint version";
+        return false;
+    }
+    if (!get(in, config) || config.policy < POLICY_FCFS || config.policy > POLICY_RR) {
+        error = "bad settings";
+        return false;
+    }
+    return true;
+}
+
+//one algorithm on one CPU over an open-ended stream of processes: arrivals are
+//generated one at a time as the clock reaches them, into the slot of a process
+//that terminated or, with every slot taken, into twice as many slots, so memory
+//follows the live processes and not the horizon; the scheduling is the
+//SmpScheduler of the batch runs, and the whole state can be checkpointed and
+//resumed (statistics only, no trace)
+template <typename SchedulerPolicy>
+class StreamSimulator {
+public:
+    static const uint32_t FIRST_SLOTS = 64;
+
+    StreamSimulator(const StreamConfig& config, long seed, const SchedulerPolicy& policy)
+        : config(config), generator(seed, config.lambda, config.bound), view(slots.view()), trace(std::cout, TRACE_NONE),
+          scheduler(view, policy, 1, false, config.tcs, trace), current_time(0), end_time(0), next_arrival(0), arrived(0) {
+        scheduler.exit_to(&free_slots);
+        next_arrival = draw_gap();
+        scheduler.schedule(next_arrival);
+    }
+
+    StreamSimulator(const StreamSimulator&) = delete;
+    StreamSimulator& operator=(const StreamSimulator&) = delete;
+
+    //simulates everything before time (at most the horizon); the clock stops
+    //on the first event at or after it, which the next call starts with
+    void run_until(int time) {
+        time = std::min(time, config.horizon);
+        while (current_time < time) {
+            scheduler.set_time(current_time);
+            while (next_arrival <= current_time)
+                admit();
+            scheduler.settle();
+            current_time = scheduler.advance();
+        }
+        end_time = std::max(end_time, time);
+    }
+
+    bool finished() const {
+        return end_time >= config.horizon;
+    }
+
+    //how far the run has been simulated, never past the horizon
+    int now() const {
+        return end_time;
+    }
+
+    uint64_t arrivals() const {
+        return arrived;
+    }
+
+    uint64_t terminations() const {
+        return scheduler.terminations();
+    }
+
+    SimSummary summary() const {
+        return scheduler.summary(end_time);
+    }
+
+    //writes the checkpoint to path through a temporary file, so a crash while
+    //writing leaves the previous one in place
+    bool save(const std::string& path) const {
+        std::string temporary = path + ".tmp";
+        std::ofstream out(temporary.c_str(), std::ios::binary);
+        if (!out)
+            return false;
+        CheckpointHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.max_bursts = STREAM_MAX_BURSTS;
+        put(out, header);
+        put(out, config);
+        put(out, generator.position());
+        put(out, current_time);
+        put(out, end_time);
+        put(out, next_arrival);
+        put(out, arrived);
+        put(out, slots.size());
+        put(out, slots.arrival_time);
+        put(out, slots.is_cpu_bound);
+        put(out, slots.num_bursts);
+        put(out, slots.cpu_bursts);
+        put(out, slots.io_bursts);
+        //free slots in the order arrivals take them, ties in the ready queue go by slot
+        put(out, free_slots);
+        scheduler.save(out);
+        out.close();
+        return out && rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    //the rest of the checkpoint after read_checkpoint_config(), into a simulator built with its config
+    bool load(std::istream& in, std::string& error) {
+        uint64_t position;
+        uint32_t size;
+        if (!get(in, position) || !get(in, current_time) || !get(in, end_time) || !get(in, next_arrival) || !get(in, arrived) || !get(in, size)
+            || size > std::max<uint64_t>(FIRST_SLOTS, 2 * arrived)) {
+            error = "truncated simulator state";
+            return false;
+        }
+        generator.seek(position);
+        resize(size);
+        if (!get(in, slots.arrival_time) || !get(in, slots.is_cpu_bound) || !get(in, slots.num_bursts) || !get(in, slots.cpu_bursts)
+            || !get(in, slots.io_bursts)) {
+            error = "bad process slots";
+            return false;
+        }
+        for (uint32_t p = 0; p < size; p++) {
+            if (slots.num_bursts[p] < 1 || slots.num_bursts[p] > STREAM_MAX_BURSTS) {
+                error = "bad process slots";
+                return false;
+            }
+        }
+        if (!get_resized(in, free_slots) || free_slots.size() > size) {
+            error = "bad free slots";
+            return false;
+        }
+        for (size_t k = 0; k < free_slots.size(); k++) {
+            if (free_slots[k] >= size) {
+                error = "bad free slots";
+                return false;
+            }
+        }
+        if (!scheduler.load(in)) {
+            error = "bad scheduler state";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    int draw_gap() {
+        return next_arrival + (int)floor(-log(generator.uniform()) * config.interarrival);
+    }
+
+    //generates the process arriving now, in the free slot arrivals take next
+    void admit() {
+        if (free_slots.empty())
+            grow();
+        uint32_t p = free_slots.back();
+        free_slots.pop_back();
+        arrived++;
+        slots.arrival_time[p] = next_arrival;
+        slots.is_cpu_bound[p] = generator.uniform() < config.cpu_share;
+        slots.num_bursts[p] = std::max(1.0, ceil(STREAM_MAX_BURSTS * generator.uniform()));
+        uint32_t first = slots.first_burst[p];
+        generator.fill_bursts(slots.is_cpu_bound[p], slots.num_bursts[p], slots.cpu_bursts.data() + first, slots.io_bursts.data() + first);
+        scheduler.arrive(p);
+        next_arrival = draw_gap();
+        scheduler.schedule(next_arrival);
+    }
+
+    //every slot is taken: twice as many, the new ones free lowest first
+    void grow() {
+        uint32_t size = slots.size();
+        resize(std::max(FIRST_SLOTS, 2 * size));
+        for (uint32_t p = slots.size(); p > size; p--)
+            free_slots.push_back(p - 1);
+    }
+
+    //slots up to size, each with STREAM_MAX_BURSTS bursts of room in the pools
+    void resize(uint32_t size) {
+        slots.reserve(size, size * STREAM_MAX_BURSTS);
+        while (slots.size() < size)
+            slots.add_bursts(slots.add(0, false), STREAM_MAX_BURSTS);
+        view = slots.view();
+        scheduler.resize(size);
+    }
+
+    StreamConfig config;
+    WorkloadGenerator generator;
+    ProcessTable slots; //the live processes and the slots of terminated ones
+    Workload view;      //of slots, what the scheduler runs on
+    TraceSink trace;
+    std::vector<uint32_t> free_slots;
+    SmpScheduler<SchedulerPolicy> scheduler;
+    int current_time; //the next event to simulate
+    int end_time;     //simulated up to here
+    int next_arrival;
+    uint64_t arrived;
+};
+
+//one point of a parameter sweep, the eight command line arguments
+struct SweepConfig {
+    int n;
+    int ncpu;
+    long seed;
+    double lambda;
+    int bound;
+    int tcs;
+    double alpha;
+    int tslice;
+};
+
+//the workload and scheduling parameters of every mode, reported if they are
+//out of range: with lambda <= 0 next_exp() never returns and tau overflows,
+//with tslice <= 0 RR never gets anywhere
+bool check_parameters(double lambda, int bound, int tcs, int tslice) {
+    if (lambda > 0 && bound >= 0 && tcs >= 0 && tslice > 0)
+        return true;
+    std::cerr << "ERROR: <Invalid workload or scheduling parameters>" << std::endl;
+    return false;
+}
+
+//a sweep argument, comma separated values and lo:hi or lo:hi:step ranges
+bool parse_values(const std::string& spec, std::vector<double>& values) {
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(',', start);
+        if (end == std::string::npos)
+            end = spec.size();
+        std::string item = spec.substr(start, end - start);
+        double range[3] = {0, 0, 1};
+        int parts = 0;
+        const char* text = item.c_str();
+        while (parts < 3) {
+            char* rest;
+            range[parts++] = strtod(text, &rest);
+            if (rest == text)
+                return false;
+            if (*rest == '\0')
+                break;
+            if (*rest != ':' || parts == 3)
+                return false;
+            text = rest + 1;
+        }
+        if (parts == 1) {
+            values.push_back(range[0]);
+        } else {
+            if (range[2] <= 0 || range[1] < range[0])
+                return false;
+            for (long k = 0; range[0] + k * range[2] <= range[1] + 1e-9 * range[2]; k++)
+                values.push_back(range[0] + k * range[2]);
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+//options shared by a normal run, --sweep and --bench (--format= only for the
+//modes that print a table)
+struct RunOptions {
+    int cores;
+    bool per_core_queues;
+    bool json;
+
+    RunOptions() : cores(1), per_core_queues(false), json(false) {}
 };
 
-double next_exp(double lambda, int bound){
-    double r=drand48();
-    double x=-log(r)/lambda;
-    if (x>bound)
-        return next_exp(lambda, bound);
-    return x;
+enum OptionResult { OPTION_UNKNOWN, OPTION_USED, OPTION_INVALID };
+
+//takes option if it is one of RunOptions', printing the error when its value is bad
+OptionResult parse_run_option(const std::string& option, RunOptions& options, bool table) {
+    if (option.compare(0, 7, "--cpus=") == 0) {
+        options.cores = std::atoi(option.c_str() + 7);
+        if (options.cores < 1) {
+            std::cerr << "ERROR: <Number of CPUs must be positive>" << std::endl;
+            return OPTION_INVALID;
+        }
+    }
+    else if (option == "--queues=global")
+        options.per_core_queues = false;
+    else if (option == "--queues=steal")
+        options.per_core_queues = true;
+    else if (table && option == "--format=csv")
+        options.json = false;
+    else if (table && option == "--format=json")
+        options.json = true;
+    else
+        return OPTION_UNKNOWN;
+    return OPTION_USED;
 }
 
-void print_queue(std::queue<Process> queue){
-    if(queue.empty()){
-        std::cout << " empty]" << std::endl;
-        return;
+//a table of named cells, written as CSV with a header taken from the first
+//row or as a JSON array with one object per row
+class TableWriter {
+public:
+    TableWriter(std::ostream& out, bool json) : out(out), json(json), rows(0) {
+        if (json)
+            out << "[";
     }
-    while (!queue.empty()) {
-        Process p = queue.front();
-        std::cout << " " << p.id;
-        queue.pop();
+
+    //a number, as precision decimals (or the stream's default format for -1)
+    void add(const std::string& key, double value, int precision = -1) {
+        std::ostringstream text;
+        if (precision >= 0)
+            text << std::fixed << std::setprecision(precision);
+        text << value;
+        row.push_back(std::make_pair(key, text.str()));
     }
-    std::cout << "]" << std::endl;
-}
 
-void simulate_fcfs1(std::vector<Process> processes, int tcs, std::ofstream& outfile) {
-    bool printAll = true;
-    std::queue<Process> ready_queue;  //store Process objects directly
-    std::vector<Process> io_queue;  //store Process objects directly
-    int current_time = 0;
-    bool printInitial = true;
-    Process current_process;
-    bool has_current_process = false;
-    bool contextSwitching = false;
+    void add(const std::string& key, long value) {
+        row.push_back(std::make_pair(key, std::to_string(value)));
+    }
 
-    //check if any processes arrive at time 0
-    while (!processes.empty() && processes.front().arrival_time == 0) {
-        ready_queue.push(processes.front());
-        std::cout << "time 0ms: Process " << processes.front().id << " arrived; added to ready queue [Q";
-        print_queue(ready_queue);
-        processes.erase(processes.begin());
-        printInitial = false;
+    void add(const std::string& key, int value) {
+        add(key, (long)value);
     }
 
-    if (printInitial) {
-        std::cout << "time 0ms: Simulator started for FCFS [Q empty]" << std::endl;
-        current_time = processes.front().arrival_time;
+    //text, quoted in JSON
+    void add(const std::string& key, const char* value) {
+        row.push_back(std::make_pair(key, json ? std::string("\"") + value + "\"" : std::string(value)));
     }
 
-    while ((!processes.empty() || !ready_queue.empty() || !io_queue.empty() || has_current_process)) {
-        //check if any processes arrive
-        for (std::vector<Process>::iterator it = processes.begin(); it != processes.end(); ) {
-            if (it->arrival_time == current_time) {
-                ready_queue.push(*it);
-                std::cout << "time " << current_time << "ms: Process " << it->id << " arrived; added to ready queue [Q";
-                print_queue(ready_queue);
-                it = processes.erase(it);
-            } else {
-                ++it;
+    //no value, an empty CSV cell or null in JSON
+    void add_missing(const std::string& key) {
+        row.push_back(std::make_pair(key, std::string(json ? "null" : "")));
+    }
+
+    void end_row() {
+        if (json) {
+            out << (rows > 0 ? ",\n  {" : "\n  {");
+            for (size_t k = 0; k < row.size(); k++)
+                out << (k > 0 ? ", \"" : "\"") << row[k].first << "\": " << row[k].second;
+            out << "}";
+        } else {
+            if (rows == 0) {
+                for (size_t k = 0; k < row.size(); k++)
+                    out << (k > 0 ? "," : "") << row[k].first;
+                out << "\n";
             }
+            for (size_t k = 0; k < row.size(); k++)
+                out << (k > 0 ? "," : "") << row[k].second;
+            out << "\n";
         }
+        row.clear();
+        rows++;
+    }
 
-        //check if any processes are done with IO
-        for (std::vector<Process>::iterator it = io_queue.begin(); it != io_queue.end(); ) {
-            if (it->arrival_time == current_time) {
-                ready_queue.push(*it);
-                if (current_time < 10000 || printAll) {
-                    std::cout << "time " << current_time << "ms: Process " << it->id << " completed I/O; added to ready queue [Q";
-                    print_queue(ready_queue);
-                }
-                it = io_queue.erase(it);
-            } else {
-                ++it;
-            }
+    void finish() {
+        if (json)
+            out << "\n]\n";
+    }
+
+private:
+    std::ostream& out;
+    bool json;
+    size_t rows;
+    std::vector<std::pair<std::string, std::string> > row;
+};
+
+//the combined sweep table, one row per configuration and algorithm
+void write_sweep(std::ostream& out, const std::vector<SweepConfig>& configs, const std::vector<SimSummary>& results, int cores, bool json) {
+    static const char* classes[3] = {"cpu_bound_", "io_bound_", ""};
+    TableWriter table(out, json);
+    for (size_t i = 0; i < results.size(); i++) {
+        const SweepConfig& config = configs[i / 4];
+        const SimSummary& summary = results[i];
+        table.add("n", config.n);
+        table.add("ncpu", config.ncpu);
+        table.add("seed", config.seed);
+        table.add("lambda", config.lambda);
+        table.add("bound", config.bound);
+        table.add("tcs", config.tcs);
+        table.add("alpha", config.alpha);
+        table.add("tslice", config.tslice);
+        table.add("cpus", cores);
+        table.add("algorithm", policy_name((Policy)(i % 4)));
+        table.add("cpu_utilization", ceil3(summary.utilization), 3);
+        for (int c = 0; c < 3; c++)
+            table.add(std::string(classes[c]) + "wait_time", ceil3(summary.wait_time[c]), 3);
+        for (int c = 0; c < 3; c++)
+            table.add(std::string(classes[c]) + "turnaround_time", ceil3(summary.turnaround_time[c]), 3);
+        for (int c = 0; c < 3; c++)
+            table.add(std::string(classes[c]) + "context_switches", summary.context_switches[c]);
+        for (int c = 0; c < 3; c++)
+            table.add(std::string(classes[c]) + "preemptions", summary.preemptions[c]);
+        for (int c = 0; c < 3; c++)
+            table.add(std::string(classes[c]) + "migrations", summary.migrations[c]);
+        //only RR has time slices, the others get an empty cell (null in JSON)
+        for (int c = 0; c < 3; c++) {
+            if (summary.has_slices)
+                table.add(std::string(classes[c]) + "one_slice_percentage", ceil3(summary.one_slice[c]), 3);
+            else
+                table.add_missing(std::string(classes[c]) + "one_slice_percentage");
         }
+        table.end_row();
+    }
+    table.finish();
+}
 
-        //check if CPU is idle
-        if (!has_current_process && ready_queue.empty()) {
-            current_time++;
-            continue;
+//sweep mode: every combination of the argument values, simulated on a pool of
+//worker threads that each generate their own workload
+int run_sweep(int argc, char* argv[]) {
+    static const char* arguments[8] = {"n", "ncpu", "seed", "lambda", "bound", "t_cs", "alpha", "t_slice"};
+    if (argc < 10) {
+        std::cerr << "ERROR: <Incorrect number of arguments>" << std::endl;
+        return 1;
+    }
+    std::vector<double> values[8];
+    for (int i = 0; i < 8; i++) {
+        if (!parse_values(argv[i + 2], values[i])) {
+            std::cerr << "ERROR: <Invalid values for " << arguments[i] << ">" << std::endl;
+            return 1;
         }
+    }
 
-        if(contextSwitching){
-            if(current_process.context_switch == 1){
-                int burst_time = current_process.cpu_bursts[current_process.current_burst_index];
-                if (current_time < 10000 || printAll) {
-                    std::cout << "time " << current_time << "ms: Process " << current_process.id << " started using the CPU for " << burst_time << "ms burst [Q";
-                    print_queue(ready_queue);
-                }
-                current_process.done_time = current_time + burst_time;
-                contextSwitching = false;
-            } else {
-                current_process.context_switch--;
-                current_time++;
-                continue;
+    int jobs = std::max(1u, std::thread::hardware_concurrency());
+    RunOptions options;
+    for (int i = 10; i < argc; i++) {
+        std::string option = argv[i];
+        OptionResult shared = parse_run_option(option, options, true);
+        if (shared == OPTION_INVALID)
+            return 1;
+        if (shared == OPTION_USED)
+            continue;
+        if (option.compare(0, 7, "--jobs=") == 0) {
+            jobs = std::atoi(option.c_str() + 7);
+            if (jobs < 1) {
+                std::cerr << "ERROR: <Number of jobs must be positive>" << std::endl;
+                return 1;
             }
         }
+        else {
+            std::cerr << "ERROR: <Unknown option " << option << ">" << std::endl;
+            return 1;
+        }
+    }
 
-        //handle the current process in the CPU
-        if (has_current_process) {
-            if (current_process.done_time == current_time) {
-                if (current_process.current_burst_index < current_process.cpu_bursts.size()-1) {
-                    int io_time = current_process.io_bursts[current_process.current_burst_index];
-                    current_process.arrival_time = current_time + io_time + tcs / 2;
-                    current_process.current_burst_index++;
-                    io_queue.push_back(current_process);
-                    if (current_time < 10000 || printAll) {
-                        std::cout << "time " << current_time << "ms: Process " << current_process.id << " completed a CPU burst; "
-                                  << current_process.cpu_bursts.size() - current_process.current_burst_index << " bursts to go [Q";
-                        print_queue(ready_queue);
-                        std::cout << "time " << current_time << "ms: Process " << current_process.id << " switching out of CPU; blocking on I/O until time "
-                                  << current_time + io_time + tcs / 2 << "ms [Q";
-                        print_queue(ready_queue);
-                    }
-
-                } else {
-                    if (current_time < 10000 || printAll || current_process.current_burst_index == current_process.cpu_bursts.size()) {
-                        std::cout << "time " << current_time << "ms: Process " << current_process.id << " terminated [Q";
-                        print_queue(ready_queue);
-                    }
-                }
-                contextSwitching = true;
-                has_current_process = false;
-            }
+    //every combination, the last argument varying fastest
+    std::vector<SweepConfig> configs;
+    size_t total = 1;
+    for (int i = 0; i < 8; i++)
+        total *= values[i].size();
+    for (size_t k = 0; k < total; k++) {
+        double v[8];
+        size_t rest = k;
+        for (int i = 7; i >= 0; i--) {
+            v[i] = values[i][rest % values[i].size()];
+            rest /= values[i].size();
+        }
+        SweepConfig config = {(int)v[0], (int)v[1], (long)v[2], v[3], (int)v[4], (int)v[5], v[6], (int)v[7]};
+        if (config.n < 0 || config.ncpu < 0 || config.ncpu > config.n || config.bound < 0) {
+            std::cerr << "ERROR: <Invalid configuration n=" << config.n << " ncpu=" << config.ncpu << " bound=" << config.bound << ">" << std::endl;
+            return 1;
         }
+        if (!check_parameters(config.lambda, config.bound, config.tcs, config.tslice))
+            return 1;
+        configs.push_back(config);
+    }
 
-        //process the next process in ready queue
-        if ((!has_current_process && !ready_queue.empty())) {
-            current_process = ready_queue.front();
-            ready_queue.pop();
-            has_current_process = true;
-            current_process.context_switch = tcs / 2;
-            if(contextSwitching){
-                current_process.context_switch += tcs / 2;
-            } else {
-                contextSwitching = true;
+    std::vector<SimSummary> results(configs.size() * 4);
+    std::atomic<size_t> next_config(0);
+    auto worker = [&]() {
+        std::ostringstream discard;
+        TraceSink trace(discard, TRACE_NONE);
+        for (size_t i = next_config++; i < configs.size(); i = next_config++) {
+            const SweepConfig& config = configs[i];
+            ProcessTable processes;
+            WorkloadGenerator(config.seed, config.lambda, config.bound).generate(processes, config.n, config.ncpu);
+            for (int k = 0; k < 4; k++) {
+                results[i * 4 + k] = run_policy(processes.view(), (Policy)k, options.cores, options.per_core_queues, config.tcs, config.lambda,
+                                                config.alpha, config.tslice, PolicyOptions(), trace);
             }
         }
+    };
+    std::vector<std::thread> threads;
+    for (int j = 0; j < jobs; j++)
+        threads.push_back(std::thread(worker));
+    for (size_t j = 0; j < threads.size(); j++)
+        threads[j].join();
 
-        current_time ++;
-    }
-    std::cout << "time " << current_time + tcs / 2 - 1<< "ms: Simulator ended for FCFS [Q empty]" << std::endl;
+    write_sweep(std::cout, configs, results, options.cores, options.json);
+    return 0;
+}
+
+//heap allocations made while count_allocations is set, which only --bench
+//does around a timed run so it can report allocations per event
+std::atomic<bool> count_allocations(false);
+std::atomic<long> allocation_count(0);
 
+//every form of operator new below allocates through here and every form of
+//operator delete frees with free(), so the replaced set stays consistent
+void* allocate(size_t size, size_t alignment) {
+    if (count_allocations.load(std::memory_order_relaxed))
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+    if (alignment <= alignof(std::max_align_t))
+        return malloc(size);
+    void* memory = nullptr;
+    return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
 }
 
-void simulate_rr(std::vector<Process> processes, int tcs, int tslice, std::ofstream& outfile) {
-    bool printAll = true;
-    std::queue<Process> ready_queue;
-    std::vector<Process> io_queue;
-    int current_time = 0;
-    bool printInitial = true;
-    Process current_process;
-    bool has_current_process = false;
-    bool contextSwitching = false;
-    std::vector<Process> initial_processes(processes);
+void* allocate_or_throw(size_t size, size_t alignment) {
+    void* memory = allocate(size, alignment);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
 
-    //check if any processes arrive at time 0
-    while (!processes.empty() && processes.front().arrival_time == 0) {
-        ready_queue.push(processes.front());
-        std::cout << "time 0ms: Process " << processes.front().id << " arrived; added to ready queue [Q";
-        print_queue(ready_queue);
-        processes.erase(processes.begin());
-        printInitial = false;
+void* operator new(size_t size) {
+    return allocate_or_throw(size, 0);
+}
+
+void* operator new[](size_t size) {
+    return allocate_or_throw(size, 0);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, (size_t)alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, (size_t)alignment);
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    free(memory);
+}
+
+//starts a new peak resident set measurement (Linux only, elsewhere a no-op)
+void reset_peak_rss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+//peak resident set size in kB since reset_peak_rss(), 0 if it is not known
+long peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::atol(line.c_str() + 6);
     }
+    return 0;
+}
 
-    if (printInitial) {
-        std::cout << "time 0ms: Simulator started for RR [Q empty]" << std::endl;
-        current_time = processes.front().arrival_time;
+//one simulation timed by benchmark mode
+struct BenchResult {
+    int n;
+    int ncpu;
+    double lambda;
+    int bound;
+    Policy policy;
+    double seconds;
+    long events;
+    long peak_rss_kb;
+    long allocations;
+};
+
+void write_bench(std::ostream& out, const std::vector<BenchResult>& results, int cores, bool json) {
+    TableWriter table(out, json);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        table.add("n", result.n);
+        table.add("ncpu", result.ncpu);
+        table.add("lambda", result.lambda);
+        table.add("bound", result.bound);
+        table.add("cpus", cores);
+        table.add("algorithm", policy_name(result.policy));
+        table.add("wall_ms", 1000 * result.seconds, 3);
+        table.add("events", result.events);
+        table.add("events_per_sec", result.seconds > 0 ? result.events / result.seconds : 0, 0);
+        table.add("peak_rss_kb", result.peak_rss_kb);
+        table.add("allocations", result.allocations);
+        table.add("allocations_per_event", result.events > 0 ? (double)result.allocations / result.events : 0, 6);
+        table.end_row();
     }
+    table.finish();
+}
 
-    while ((!processes.empty() || !ready_queue.empty() || !io_queue.empty() || has_current_process)) {
-        //check if any processes arrive
-        for (std::vector<Process>::iterator it = processes.begin(); it != processes.end(); ) {
-            if (it->arrival_time == current_time) {
-                ready_queue.push(*it);
-                std::cout << "time " << current_time << "ms: Process " << it->id << " arrived; added to ready queue [Q";
-                print_queue(ready_queue);
-                it = processes.erase(it);
-            } else {
-                ++it;
+//benchmark mode: every algorithm on generated workloads of growing size, one at a
+//time with no trace so the numbers are the scheduling loop's own; the other
+//arguments are fixed (a quarter CPU-bound, seed 2, t_cs 4, alpha 0.75, t_slice 256);
+//MLFQ and CFS only run when asked for, CFS steps through ~100x the events of RR
+int run_bench(int argc, char* argv[]) {
+    std::vector<Policy> policies = {POLICY_FCFS, POLICY_SJF, POLICY_SRT, POLICY_RR};
+    std::vector<double> sizes;
+    std::vector<double> lambdas;
+    std::vector<double> bounds;
+    RunOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string option = argv[i];
+        OptionResult shared = parse_run_option(option, options, true);
+        if (shared == OPTION_INVALID)
+            return 1;
+        if (shared == OPTION_USED)
+            continue;
+        if (option.compare(0, 4, "--n=") == 0) {
+            if (!parse_values(option.substr(4), sizes)) {
+                std::cerr << "ERROR: <Invalid values for n>" << std::endl;
+                return 1;
+            }
+        }
+        else if (option.compare(0, 9, "--lambda=") == 0) {
+            if (!parse_values(option.substr(9), lambdas)) {
+                std::cerr << "ERROR: <Invalid values for lambda>" << std::endl;
+                return 1;
+            }
+        }
+        else if (option.compare(0, 8, "--bound=") == 0) {
+            if (!parse_values(option.substr(8), bounds)) {
+                std::cerr << "ERROR: <Invalid values for bound>" << std::endl;
+                return 1;
             }
         }
+        else if (option == "--mlfq")
+            policies.push_back(POLICY_MLFQ);
+        else if (option == "--cfs")
+            policies.push_back(POLICY_CFS);
+        else {
+            std::cerr << "ERROR: <Unknown option " << option << ">" << std::endl;
+            return 1;
+        }
+    }
+    if (sizes.empty())
+        sizes = {10, 100, 1000, 10000, 100000, 1000000};
+    if (lambdas.empty())
+        lambdas = {0.01, 0.001};
+    if (bounds.empty())
+        bounds = {1024};
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (sizes[i] < 0) {
+            std::cerr << "ERROR: <n is negative>" << std::endl;
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < bounds.size(); i++) {
+        if (bounds[i] < 0) {
+            std::cerr << "ERROR: <upper bound is negative>" << std::endl;
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < lambdas.size(); i++) {
+        if (!check_parameters(lambdas[i], 0, 4, 256))
+            return 1;
+    }
 
-        //check if any processes are done with IO
-        for (std::vector<Process>::iterator it = io_queue.begin(); it != io_queue.end(); ) {
-            if (it->arrival_time == current_time) {
-                ready_queue.push(*it);
-                if (current_time < 10000 || printAll) {
-                    std::cout << "time " << current_time << "ms: Process " << it->id << " completed I/O; added to ready queue [Q";
-                    print_queue(ready_queue);
+    std::vector<BenchResult> results;
+    std::ostringstream discard;
+    TraceSink trace(discard, TRACE_NONE);
+    for (size_t a = 0; a < sizes.size(); a++) {
+        for (size_t b = 0; b < lambdas.size(); b++) {
+            for (size_t c = 0; c < bounds.size(); c++) {
+                int n = sizes[a];
+                ProcessTable processes;
+                WorkloadGenerator(2, lambdas[b], bounds[c]).generate(processes, n, n / 4);
+                for (size_t k = 0; k < policies.size(); k++) {
+                    reset_peak_rss();
+                    long allocations = allocation_count.load();
+                    count_allocations = true;
+                    auto start = std::chrono::steady_clock::now();
+                    SimSummary summary = run_policy(processes.view(), policies[k], options.cores, options.per_core_queues, 4, lambdas[b], 0.75,
+                                                    256, PolicyOptions(), trace);
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    count_allocations = false;
+                    if (!check_run_time(processes.view(), summary, policies[k]))
+                        return 1;
+                    BenchResult result = {n, n / 4, lambdas[b], (int)bounds[c], policies[k], elapsed.count(), summary.events, peak_rss_kb(),
+                                          allocation_count.load() - allocations};
+                    results.push_back(result);
                 }
-                it = io_queue.erase(it);
-            } else {
-                ++it;
             }
         }
+    }
 
-        //check if idle
-        if (!has_current_process && ready_queue.empty()) {
-            current_time++;
-            continue;
+    write_bench(std::cout, results, options.cores, options.json);
+    return 0;
+}
+
+//export mode: a telemetry file as Chrome trace-event JSON (chrome://tracing or
+//Perfetto), one process per algorithm and one thread per CPU; CPU runs and
+//context switches become slices, the other events instants; both files are streamed
+int run_export(int argc, char* argv[]) {
+    if (argc != 4) {
+        std::cerr << "ERROR: <Incorrect number of arguments>" << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[2], std::ios::binary);
+    if (!in) {
+        std::cerr << "ERROR: <Could not open " << argv[2] << ">" << std::endl;
+        return 1;
+    }
+    TelemetryHeader header;
+    in.read((char*)&header, sizeof(header));
+    if (!in || memcmp(header.magic, TELEMETRY_MAGIC, sizeof(header.magic)) != 0 || header.version != TELEMETRY_VERSION
+        || header.record_size != sizeof(TelemetryRecord)) {
+        std::cerr << "ERROR: <Not a telemetry file " << argv[2] << ">" << std::endl;
+        return 1;
+    }
+    std::ofstream out(argv[3]);
+    if (!out) {
+        std::cerr << "ERROR: <Could not open " << argv[3] << " for writing>" << std::endl;
+        return 1;
+    }
+
+    //open slices of one CPU of one algorithm: [0] a CPU run, [1] switching in, [2] switching out
+    struct Track {
+        int policy;
+        int core;
+        int start[3];
+    };
+    static const char* slice_names[3] = {"", "switch in ", "switch out "};
+    std::vector<Track> tracks;
+    std::vector<bool> named(POLICY_CFS + 1, false);
+    bool first = true;
+    auto event = [&]() -> std::ostream& {
+        out << (first ? "\n  {" : ",\n  {");
+        first = false;
+        return out;
+    };
+    auto name_of = [](uint32_t p) {
+        char text[8];
+        return std::string(text, ProcessId{p}.format(text));
+    };
+    auto track_of = [&](const TelemetryRecord& record) -> Track& {
+        for (size_t i = 0; i < tracks.size(); i++) {
+            if (tracks[i].policy == record.policy && tracks[i].core == record.core)
+                return tracks[i];
         }
+        if (record.policy < named.size() && !named[record.policy]) {
+            named[record.policy] = true;
+            event() << "\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << (int)record.policy << ", \"args\": {\"name\": \""
+                    << policy_name((Policy)record.policy) << "\"}}";
+        }
+        event() << "\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << (int)record.policy << ", \"tid\": " << record.core
+                << ", \"args\": {\"name\": \"CPU " << record.core << "\"}}";
+        Track track = {record.policy, record.core, {-1, -1, -1}};
+        tracks.push_back(track);
+        return tracks.back();
+    };
+    auto open_slice = [&](const TelemetryRecord& record, int kind) {
+        track_of(record).start[kind] = record.time;
+    };
+    auto close_slice = [&](const TelemetryRecord& record, int kind, const char* end) {
+        Track& track = track_of(record);
+        if (track.start[kind] < 0)
+            return;
+        event() << "\"name\": \"" << slice_names[kind] << name_of(record.process) << "\", \"ph\": \"X\", \"ts\": " << 1000LL * track.start[kind]
+                << ", \"dur\": " << 1000LL * (record.time - track.start[kind]) << ", \"pid\": " << (int)record.policy << ", \"tid\": " << record.core;
+        if (end)
+            out << ", \"args\": {\"end\": \"" << end << "\"}";
+        out << "}";
+        track.start[kind] = -1;
+    };
+    auto instant = [&](const TelemetryRecord& record, const char* what) {
+        track_of(record);
+        event() << "\"name\": \"" << name_of(record.process) << " " << what << "\", \"ph\": \"i\", \"s\": \"t\", \"ts\": " << 1000LL * record.time
+                << ", \"pid\": " << (int)record.policy << ", \"tid\": " << record.core << "}";
+    };
 
-        if (contextSwitching) {
-            if (current_process.context_switch == 1) {
-                int burst_time = current_process.cpu_bursts[current_process.current_burst_index];
-                if (current_time < 10000 || printAll) {
-                    Process initial_process;
-                    std::cout << "time " << current_time << "ms: Process " << current_process.id << " started using the CPU for ";
-                    bool preempted = false; //keeps track of if the process has been preempted for output thingy
-                    for (std::vector<Process>::iterator it = initial_processes.begin(); it != initial_processes.end(); ++it) {
-                        if(it->id == current_process.id){
-                            if(it->cpu_bursts[current_process.current_burst_index] != current_process.cpu_bursts[current_process.current_burst_index]){
-                                preempted = true;
-                                initial_process = *it;
-                            }
-                            break;
-                        }
-                    }
-                    if(preempted){
-                        std::cout << "remaining " << burst_time << "ms of " << initial_process.cpu_bursts[current_process.current_burst_index] << "ms burst [Q";
-                    } else {
-                        std::cout<< burst_time << "ms burst [Q";
-                    }
-                    print_queue(ready_queue);
-                }
-                current_process.done_time = current_time + std::min(tslice, burst_time);
-                contextSwitching = false;
-            } else {
-                current_process.context_switch--;
-                current_time++;
+    out << "{\"traceEvents\": [";
+    std::vector<TelemetryRecord> records(4096);
+    while (in.read((char*)records.data(), records.size() * sizeof(TelemetryRecord)) || in.gcount() > 0) {
+        size_t count = in.gcount() / sizeof(TelemetryRecord);
+        for (size_t i = 0; i < count; i++) {
+            const TelemetryRecord& record = records[i];
+            if (record.policy >= named.size())
                 continue;
+            switch (record.kind) {
+            case EVENT_DISPATCH:
+                open_slice(record, 0);
+                break;
+            case EVENT_BURST_DONE:
+                close_slice(record, 0, "burst done");
+                break;
+            case EVENT_PREEMPT:
+                close_slice(record, 0, "preempted");
+                break;
+            case EVENT_SWITCH_BEGIN:
+                open_slice(record, 1 + (record.value != 0));
+                break;
+            case EVENT_SWITCH_END:
+                close_slice(record, 1 + (record.value != 0), nullptr);
+                break;
+            case EVENT_ARRIVAL:
+                instant(record, "arrived");
+                break;
+            case EVENT_IO_BLOCK:
+                instant(record, "blocked on I/O");
+                break;
+            case EVENT_IO_DONE:
+                instant(record, "completed I/O");
+                break;
+            case EVENT_TERMINATE:
+                instant(record, "terminated");
+                break;
             }
         }
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    if (!out) {
+        std::cerr << "ERROR: <Could not write " << argv[3] << ">" << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-        //current process
-        if (has_current_process) {
-            if (current_process.done_time == current_time) {
-                int burst_time = current_process.cpu_bursts[current_process.current_burst_index];
-
-                if (burst_time > tslice) {
-                    current_process.cpu_bursts[current_process.current_burst_index] -= tslice;
-                    if(ready_queue.empty()){
-                        current_process.done_time = current_time + std::min(tslice, current_process.cpu_bursts[current_process.current_burst_index]);
-                        std::cout << "time " << current_time << "ms: Time slice expired; no preemption because ready queue is empty [Q empty]" << std::endl; 
-                        current_time ++ ;
-                        continue;
-                    }
-                    if (current_time < 10000 || printAll) {
-                        std::cout << "time " << current_time << "ms: Time slice expired; preempting process " << current_process.id << " with " << current_process.cpu_bursts[current_process.current_burst_index] << "ms remaining [Q";
-                        print_queue(ready_queue);
-                    }
-                    ready_queue.push(current_process);
-                } else {
-                    if (current_process.current_burst_index < current_process.cpu_bursts.size() - 1) {
-                        int io_time = current_process.io_bursts[current_process.current_burst_index];
-                        current_process.arrival_time = current_time + io_time + tcs / 2;
-                        current_process.current_burst_index++;
-                        io_queue.push_back(current_process);
-                        if (current_time < 10000 || printAll) {
-                            std::cout << "time " << current_time << "ms: Process " << current_process.id << " completed a CPU burst; "
-                                      << current_process.cpu_bursts.size() - current_process.current_burst_index << " bursts to go [Q";
-                            print_queue(ready_queue);
-                            std::cout << "time " << current_time << "ms: Process " << current_process.id << " switching out of CPU; blocking on I/O until time "
-                                      << current_time + io_time + tcs / 2 << "ms [Q";
-                            print_queue(ready_queue);
-                        }
-                    } else {
-                        if (current_time < 10000 || printAll || current_process.current_burst_index == current_process.cpu_bursts.size()) {
-                            std::cout << "time " << current_time << "ms: Process " << current_process.id << " terminated [Q";
-                            print_queue(ready_queue);
-                        }
-                    }
-                }
-                contextSwitching = true;
-                has_current_process = false;
-            }
+//what a streaming run does besides simulating, from the --stream or --resume options
+struct StreamRun {
+    std::string resume_path;     //checkpoint resumed from, "" for a new run
+    std::string checkpoint_path; //"" for no checkpoints
+    int checkpoint_every;        //simulated ms between checkpoints, 0 for one at the end
+    bool percentiles;
+};
+
+//a streaming run of the algorithm of policy to config.horizon, carrying on
+//from checkpoint when it is not nullptr
+template <typename SchedulerPolicy>
+int simulate_stream(const StreamConfig& config, long seed, const SchedulerPolicy& policy, std::istream* checkpoint, const StreamRun& run) {
+    StreamSimulator<SchedulerPolicy> simulator(config, seed, policy);
+    if (checkpoint) {
+        std::string error;
+        if (!simulator.load(*checkpoint, error)) {
+            std::cerr << "ERROR: <Could not resume from " << run.resume_path << ": " << error << ">" << std::endl;
+            return 1;
+        }
+        if (simulator.now() > config.horizon) {
+            std::cerr << "ERROR: <Checkpoint is already past the horizon>" << std::endl;
+            return 1;
+        }
+    }
+
+    while (!simulator.finished()) {
+        int until = config.horizon;
+        if (run.checkpoint_every > 0)
+            until = std::min((long)config.horizon, (long)simulator.now() + run.checkpoint_every);
+        simulator.run_until(until);
+        if (!run.checkpoint_path.empty() && !simulator.save(run.checkpoint_path)) {
+            std::cerr << "ERROR: <Could not write checkpoint " << run.checkpoint_path << ">" << std::endl;
+            return 1;
         }
+    }
 
-        //next process
-        if ((!has_current_process && !ready_queue.empty())) {
-            current_process = ready_queue.front();
-            ready_queue.pop();
-            has_current_process = true;
-            current_process.context_switch = tcs / 2;
-            if (contextSwitching) {
-                current_process.context_switch += tcs / 2;
-            } else {
-                contextSwitching = true;
+    const char* name = policy.name();
+    std::cout << "time " << simulator.now() << "ms: Stream of " << name << " stopped; " << simulator.arrivals() << " processes arrived, "
+              << simulator.terminations() << " terminated, " << simulator.arrivals() - simulator.terminations() << " still alive" << std::endl;
+    std::ofstream outfile("simout.txt");
+    if (!outfile) {
+        std::cerr << "ERROR: <Could not open the file for writing>" << std::endl;
+        return 1;
+    }
+    outfile << "-- number of processes arrived: " << simulator.arrivals() << std::endl;
+    outfile << "-- number of processes terminated: " << simulator.terminations() << std::endl;
+    outfile << "-- simulated time: " << simulator.now() << " ms" << std::endl;
+    write_stats(outfile, name, simulator.summary(), run.percentiles);
+    return 0;
+}
+
+//--stream n ncpu seed lambda bound tcs alpha tslice --horizon=MS [options]:
+//one algorithm on a stream of processes that keeps arriving until the
+//horizon, a share ncpu/n of them CPU-bound; --resume FILE [options] carries
+//on from a checkpoint, to its horizon or a later --horizon
+int run_stream(int argc, char* argv[]) {
+    bool resume = std::string(argv[1]) == "--resume";
+    int first_option = resume ? 3 : 10;
+    if (argc < first_option) {
+        std::cerr << "ERROR: <Incorrect number of arguments>" << std::endl;
+        return 1;
+    }
+    StreamConfig config;
+    memset(&config, 0, sizeof(config));
+    config.policy = POLICY_FCFS;
+    double interarrival = 0;
+    int horizon = -1;
+    std::string checkpoint_path;
+    int checkpoint_every = 0;
+    bool percentiles = false;
+    for (int i = first_option; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.compare(0, 10, "--horizon=") == 0)
+            horizon = std::atoi(option.c_str() + 10);
+        else if (option.compare(0, 13, "--checkpoint=") == 0)
+            checkpoint_path = option.substr(13);
+        else if (option.compare(0, 19, "--checkpoint-every=") == 0) {
+            checkpoint_every = std::atoi(option.c_str() + 19);
+            if (checkpoint_every <= 0) {
+                std::cerr << "ERROR: <Checkpoint interval must be positive>" << std::endl;
+                return 1;
             }
         }
+        else if (option == "--percentiles")
+            percentiles = true;
+        else if (!resume && option.compare(0, 12, "--algorithm=") == 0) {
+            std::string name = option.substr(12);
+            config.policy = -1;
+            for (int policy = POLICY_FCFS; policy <= POLICY_RR; policy++) {
+                if (name == policy_name((Policy)policy))
+                    config.policy = policy;
+            }
+            if (config.policy < 0) {
+                std::cerr << "ERROR: <Streaming runs FCFS, SJF, SRT or RR, not " << name << ">" << std::endl;
+                return 1;
+            }
+        }
+        else if (!resume && option.compare(0, 15, "--interarrival=") == 0) {
+            interarrival = std::atof(option.c_str() + 15);
+            if (interarrival <= 0) {
+                std::cerr << "ERROR: <Mean interarrival time must be positive>" << std::endl;
+                return 1;
+            }
+        }
+        else {
+            std::cerr << "ERROR: <Unknown option " << option << ">" << std::endl;
+            return 1;
+        }
+    }
+    if (checkpoint_every > 0 && checkpoint_path.empty()) {
+        std::cerr << "ERROR: <--checkpoint-every needs --checkpoint=FILE>" << std::endl;
+        return 1;
+    }
 
-        current_time++;
+    std::ifstream checkpoint;
+    if (resume) {
+        checkpoint.open(argv[2], std::ios::binary);
+        if (!checkpoint) {
+            std::cerr << "ERROR: <Could not open " << argv[2] << ">" << std::endl;
+            return 1;
+        }
+        std::string error;
+        if (!read_checkpoint_config(checkpoint, config, error)) {
+            std::cerr << "ERROR: <Could not resume from " << argv[2] << ": " << error << ">" << std::endl;
+            return 1;
+        }
+    } else {
+        int n = std::atoi(argv[2]);
+        int ncpu = std::atoi(argv[3]);
+        config.lambda = std::atof(argv[5]);
+        config.bound = std::atoi(argv[6]);
+        config.tcs = std::atoi(argv[7]);
+        config.alpha = std::atof(argv[8]);
+        config.tslice = std::atoi(argv[9]);
+        if (n <= 0 || ncpu < 0 || ncpu > n) {
+            std::cerr << "ERROR: <Need 0 <= ncpu <= n and n > 0>" << std::endl;
+            return 1;
+        }
+        if (!check_parameters(config.lambda, config.bound, config.tcs, config.tslice))
+            return 1;
+        config.cpu_share = (double)ncpu / n;
+        //by default about 80% of the CPU is busy: a process brings 16.5 CPU
+        //bursts on average, four times as long when it is CPU-bound
+        if (interarrival == 0)
+            interarrival = 16.5 * ((1 + 3 * config.cpu_share) / config.lambda + config.tcs) / 0.8;
+        config.interarrival = interarrival;
+        if (horizon < 0) {
+            std::cerr << "ERROR: <Streaming needs --horizon=MS>" << std::endl;
+            return 1;
+        }
     }
-    std::cout << "time " << current_time + tcs / 2 - 1 << "ms: Simulator ended for RR [Q Empty]" << std::endl;
+    if (horizon >= 0)
+        config.horizon = horizon;
+
+    StreamRun run = {resume ? argv[2] : "", checkpoint_path, checkpoint_every, percentiles};
+    long seed = resume ? 0 : std::atoi(argv[4]);
+    std::istream* from = resume ? &checkpoint : nullptr;
+    if (config.policy == POLICY_SJF)
+        return simulate_stream(config, seed, SjfPolicy(0, config.lambda, config.alpha), from, run);
+    if (config.policy == POLICY_SRT)
+        return simulate_stream(config, seed, SrtPolicy(0, config.lambda, config.alpha), from, run);
+    if (config.policy == POLICY_RR)
+        return simulate_stream(config, seed, RrPolicy(0, config.tslice), from, run);
+    return simulate_stream(config, seed, FcfsPolicy(0), from, run);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc!=9){
+    if (argc > 1 && std::string(argv[1]) == "--sweep")
+        return run_sweep(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+        return run_bench(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--export-trace")
+        return run_export(argc, argv);
+    if (argc > 1 && (std::string(argv[1]) == "--stream" || std::string(argv[1]) == "--resume"))
+        return run_stream(argc, argv);
+    if (argc<9){
         std::cerr << "ERROR: <Incorrect number of arguments>" << std::endl;
         return 1;
     }
@@ -331,13 +3853,114 @@ int main(int argc, char* argv[]) {
     int tcs = std::atoi(argv[6]);
     double alpha = std::atof(argv[7]);
     int tslice = std::atoi(argv[8]);
+    //options
+    TraceLevel trace_level = TRACE_FULL;
+    RunOptions run_options;
+    std::string load_path;
+    std::string save_path;
+    bool parallel = false;
+    std::vector<Policy> policies = {POLICY_FCFS, POLICY_SJF, POLICY_SRT, POLICY_RR};
+    PolicyOptions policy_options;
+    std::string verify_path;
+    std::string verify_stats_path;
+    std::string telemetry_path;
+    bool percentiles = false;
+    for (int i = 9; i < argc; i++) {
+        std::string option = argv[i];
+        OptionResult shared = parse_run_option(option, run_options, false);
+        if (shared == OPTION_INVALID)
+            return 1;
+        if (shared == OPTION_USED)
+            continue;
+        if (option == "--parallel")
+            parallel = true;
+        else if (option.compare(0, 6, "--mlfq") == 0 && option.compare(0, 12, "--mlfq-boost") != 0) {
+            //--mlfq or --mlfq=q0,q1,... with the quantum of each level
+            std::vector<double> quanta;
+            if (option.size() > 6 && (option[6] != '=' || !parse_values(option.substr(7), quanta))) {
+                std::cerr << "ERROR: <Invalid MLFQ quanta " << option << ">" << std::endl;
+                return 1;
+            }
+            if (!quanta.empty())
+                policy_options.quanta.assign(quanta.begin(), quanta.end());
+            for (size_t q = 0; q < policy_options.quanta.size(); q++) {
+                if (policy_options.quanta[q] <= 0) {
+                    std::cerr << "ERROR: <MLFQ quanta must be positive>" << std::endl;
+                    return 1;
+                }
+            }
+            policies.push_back(POLICY_MLFQ);
+        }
+        else if (option.compare(0, 13, "--mlfq-boost=") == 0) {
+            policy_options.boost = std::atoi(option.c_str() + 13);
+            if (policy_options.boost < 0) {
+                std::cerr << "ERROR: <MLFQ boost period is negative>" << std::endl;
+                return 1;
+            }
+        }
+        else if (option.compare(0, 5, "--cfs") == 0) {
+            //--cfs or --cfs=latency,granularity
+            std::vector<double> settings;
+            if (option.size() > 5 && (option[5] != '=' || !parse_values(option.substr(6), settings) || settings.size() != 2)) {
+                std::cerr << "ERROR: <Invalid CFS settings " << option << ">" << std::endl;
+                return 1;
+            }
+            if (!settings.empty()) {
+                policy_options.latency = settings[0];
+                policy_options.granularity = settings[1];
+            }
+            if (policy_options.latency <= 0 || policy_options.granularity <= 0) {
+                std::cerr << "ERROR: <CFS latency and granularity must be positive>" << std::endl;
+                return 1;
+            }
+            policies.push_back(POLICY_CFS);
+        }
+        else if (option.compare(0, 7, "--load=") == 0)
+            load_path = option.substr(7);
+        else if (option.compare(0, 7, "--save=") == 0)
+            save_path = option.substr(7);
+        else if (option.compare(0, 9, "--verify=") == 0)
+            verify_path = option.substr(9);
+        else if (option.compare(0, 15, "--verify-stats=") == 0)
+            verify_stats_path = option.substr(15);
+        else if (option.compare(0, 12, "--telemetry=") == 0)
+            telemetry_path = option.substr(12);
+        else if (option == "--percentiles")
+            percentiles = true;
+        else if (option == "--trace=full")
+            trace_level = TRACE_FULL;
+        else if (option == "--trace=truncated")
+            trace_level = TRACE_TRUNCATED;
+        else if (option == "--trace=none")
+            trace_level = TRACE_NONE;
+        else {
+            std::cerr << "ERROR: <Unknown option " << option << ">" << std::endl;
+            return 1;
+        }
+    }
 
-    //Output the arguments
-    if (ncpu==1)
-        std::cout << "<<< PROJECT PART I\n" << "<<< -- process set (n=" << n << ") with " << ncpu << " CPU-bound process" << std::endl;
-    else
-        std::cout << "<<< PROJECT PART I\n" << "<<< -- process set (n=" << n << ") with " << ncpu << " CPU-bound processes" << std::endl;
-    std::cout << "<<< -- seed=" << seed << "; lambda=" << std::fixed << std::setprecision(6) << lambda << "; bound=" << bound << std::endl;
+    int cores = run_options.cores;
+    bool per_core_queues = run_options.per_core_queues;
+
+    //--verify: everything for stdout is compared with the reference instead of printed
+    TraceVerifier output_check(verify_path);
+    StreamRestore restore = {std::cout, std::cout.rdbuf()};
+    if (!verify_path.empty()) {
+        if (!output_check.is_open()) {
+            std::cerr << "ERROR: <Could not open " << verify_path << ">" << std::endl;
+            return 1;
+        }
+        std::cout.rdbuf(&output_check);
+    }
+
+    //Output the arguments (a loaded workload was not generated from them)
+    if (load_path.empty()) {
+        if (ncpu==1)
+            std::cout << "<<< PROJECT PART I\n" << "<<< -- process set (n=" << n << ") with " << ncpu << " CPU-bound process" << std::endl;
+        else
+            std::cout << "<<< PROJECT PART I\n" << "<<< -- process set (n=" << n << ") with " << ncpu << " CPU-bound processes" << std::endl;
+        std::cout << "<<< -- seed=" << seed << "; lambda=" << std::fixed << std::setprecision(6) << lambda << "; bound=" << bound << std::endl;
+    }
 
     //Error checking
     if (n<0){
@@ -356,11 +3979,33 @@ int main(int argc, char* argv[]) {
         std::cerr << "ERROR: <upper bound is negative>" << std::endl;
         return 1;
     }
+    if (!check_parameters(lambda, bound, tcs, tslice))
+        return 1;
 
     //Do stuff
     //change from printing to storing
-    srand48(seed);
-
+    ProcessTable processes;
+    WorkloadFile file;
+    Workload workload;
+    if (!load_path.empty()) {
+        std::string error;
+        if (!file.open(load_path, error)) {
+            std::cerr << "ERROR: <Could not load workload " << load_path << ": " << error << ">" << std::endl;
+            return 1;
+        }
+        workload = file.workload();
+        n = workload.size();
+        ncpu = 0;
+        for (int i = 0; i < n; i++)
+            ncpu += workload.is_cpu_bound[i] ? 1 : 0;
+    } else {
+        WorkloadGenerator(seed, lambda, bound).generate(processes, n, ncpu);
+        workload = processes.view();
+    }
+    if (!save_path.empty() && !save_workload(workload, save_path)) {
+        std::cerr << "ERROR: <Could not write workload " << save_path << ">" << std::endl;
+        return 1;
+    }
 
     int numCPUBoundCPUBurst=0;
     double sumCPUBoundCPUBurst=0;
@@ -372,41 +4017,28 @@ int main(int argc, char* argv[]) {
     int numIOBoundIOBurst=0;
     double sumIOBoundIOBurst=0;
 
-    std::vector<Process> processes;
-    for (int i = 0; i < n; i++) {
-        Process p;
-        p.id = std::string(1, 'A' + (i / 10)) + std::to_string(i % 10);
-        p.arrival_time = floor(next_exp(lambda, bound));
-        int num_bursts = ceil(32 * drand48());
-        p.current_burst_index = 0;
-        p.total_cpu_time = 0;
-        p.total_wait_time = 0;
-        p.total_turnaround_time = 0;
-        // p.remaining_time = 0;
-        p.is_cpu_bound = (i < ncpu);
-        if (num_bursts==1)
-            std::cout << "CPU-bound process " << p.id << ": arrival time " << p.arrival_time << "ms; " << num_bursts << " CPU burst:" << std::endl;
-        else
-            std::cout << "CPU-bound process " << p.id << ": arrival time " << p.arrival_time << "ms; " << num_bursts << " CPU bursts:" << std::endl;
+    for (uint32_t p = 0; p < workload.size(); p++) {
+        int num_bursts = workload.num_bursts[p];
+        //the listing is part of the trace, without one it is skipped; no flush per line
+        if (load_path.empty() && trace_level != TRACE_NONE) {
+            if (num_bursts==1)
+                std::cout << "CPU-bound process " << workload.id[p] << ": arrival time " << workload.arrival_time[p] << "ms; " << num_bursts << " CPU burst:" << '\n';
+            else
+                std::cout << "CPU-bound process " << workload.id[p] << ": arrival time " << workload.arrival_time[p] << "ms; " << num_bursts << " CPU bursts:" << '\n';
+        }
 
         for (int j = 0; j < num_bursts; j++) {
-            if (i < ncpu) {
-                int burstTime = 4 * ceil(next_exp(lambda, bound));
-                p.cpu_bursts.push_back(burstTime);
+            int burstTime = workload.cpu_bursts[workload.first_burst[p] + j];
+            int ioTime = workload.io_bursts[workload.first_burst[p] + j];
+            if (workload.is_cpu_bound[p]) {
                 if (j < num_bursts - 1) {
-                    int ioTime = ceil(next_exp(lambda, bound));
-                    p.io_bursts.push_back(ioTime);
                     numCPUBoundIOBurst++;
                     sumCPUBoundIOBurst += ioTime;
                 }
                 numCPUBoundCPUBurst++;
                 sumCPUBoundCPUBurst += burstTime;
             } else {
-                int burstTime = ceil(next_exp(lambda, bound));
-                p.cpu_bursts.push_back(burstTime);
                 if (j < num_bursts - 1) {
-                    int ioTime = 8 * ceil(next_exp(lambda, bound));
-                    p.io_bursts.push_back(ioTime);
                     numIOBoundCPUBurst++;
                     sumIOBoundIOBurst += ioTime;
                 }
@@ -414,7 +4046,6 @@ int main(int argc, char* argv[]) {
                 sumIOBoundCPUBurst += burstTime;
             }
         }
-        processes.push_back(p);
     }
 
     // int numCPUBoundCPUBurst=0;
@@ -518,11 +4149,82 @@ int main(int argc, char* argv[]) {
     else
         outfile << "-- overall average I/O burst time: " << ceil(1000*(sumCPUBoundIOBurst+sumIOBoundIOBurst)/(numCPUBoundIOBurst+numIOBoundIOBurst))/1000 << " ms" << std::endl;
 
+    //every scheduling event to the telemetry file, drained in the background
+    TelemetryWriter telemetry;
+    if (!telemetry_path.empty() && !telemetry.open(telemetry_path)) {
+        std::cerr << "ERROR: <Could not open " << telemetry_path << " for writing>" << std::endl;
+        return 1;
+    }
+
     //part 2
     std::cout << "<<< PROJECT PART II\n";
     std::cout << "<<< -- t_cs=" << tcs << "ms; alpha=" << std::fixed << std::setprecision(2) << alpha << "; t_slice=" << tslice << "ms" << std::endl;
-    simulate_fcfs1(processes, tcs, outfile);
-    std::cout << std::endl;
-    simulate_rr(processes, tcs, tslice, outfile);
+    size_t runs = policies.size();
+    std::vector<SimSummary> summaries(runs);
+    if (parallel) {
+        //every algorithm on its own thread with its own trace buffer, the
+        //workload is only read so they can all share it
+        std::vector<std::ostringstream> traces(runs);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < runs; i++) {
+            threads.push_back(std::thread([&, i]() {
+                TraceSink trace(traces[i], trace_level);
+                if (telemetry.is_open())
+                    trace.set_telemetry(telemetry.ring(policies[i]));
+                summaries[i] = run_policy(workload, policies[i], cores, per_core_queues, tcs, lambda, alpha, tslice, policy_options, trace);
+            }));
+        }
+        for (size_t i = 0; i < runs; i++) {
+            threads[i].join();
+            if (i > 0)
+                std::cout << std::endl;
+            std::string text = traces[i].str();
+            std::cout.write(text.data(), text.size());
+        }
+    } else {
+        TraceSink trace(std::cout, trace_level);
+        for (size_t i = 0; i < runs; i++) {
+            if (i > 0)
+                std::cout << std::endl;
+            if (telemetry.is_open())
+                trace.set_telemetry(telemetry.ring(policies[i]));
+            summaries[i] = run_policy(workload, policies[i], cores, per_core_queues, tcs, lambda, alpha, tslice, policy_options, trace);
+            trace.flush();
+        }
+    }
+    for (size_t i = 0; i < runs; i++) {
+        if (!check_run_time(workload, summaries[i], policies[i]))
+            return 1;
+    }
+    for (size_t i = 0; i < runs; i++)
+        write_stats(outfile, policy_name(policies[i]), summaries[i], percentiles);
     outfile.close();
+    if (!telemetry.close()) {
+        std::cerr << "ERROR: <Could not write " << telemetry_path << ">" << std::endl;
+        return 1;
+    }
+
+    //report the first difference from each reference, on the real stdout
+    int status = 0;
+    if (!verify_path.empty()) {
+        std::cout.flush();
+        std::cout.rdbuf(restore.saved);
+        if (!output_check.finish())
+            status = 1;
+        output_check.report(std::cout, verify_path);
+    }
+    if (!verify_stats_path.empty()) {
+        TraceVerifier stats_check(verify_stats_path);
+        if (!stats_check.is_open()) {
+            std::cerr << "ERROR: <Could not open " << verify_stats_path << ">" << std::endl;
+            return 1;
+        }
+        std::ifstream written("simout.txt");
+        std::ostream check(&stats_check);
+        check << written.rdbuf();
+        if (!stats_check.finish())
+            status = 1;
+        stats_check.report(std::cout, verify_stats_path);
+    }
+    return status;
 }
\ No newline at end of file